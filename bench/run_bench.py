@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""run_bench.py -- Run nanamo against a benchmark page and report results
+
+Launches nanamo on one of the bundled pages for a fixed duration with
+--stats enabled, samples CPU time of nanamo and its CEF child processes from
+/proc, and prints a single JSON object with the results. With --ingest, a
+producer feeds the page through nanamo's --ingest socket meanwhile. With
+--latency-probe, nanamo clicks its own probe page instead and exits once it
+has the click to present latency of every click.
+
+Without a display, or with --xvfb, nanamo runs under xvfb-run; with
+--offscreen it needs no display at all. Mesa is forced onto llvmpipe so
+results don't depend on the GPU of the machine.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+CLK_TCK = os.sysconf("SC_CLK_TCK")
+
+
+def descendants(pid):
+    """Return pid and every process below it"""
+    pids = [pid]
+    i = 0
+    while i < len(pids):
+        task_dir = f"/proc/{pids[i]}/task"
+        try:
+            tasks = os.listdir(task_dir)
+        except OSError:
+            tasks = []
+        for task in tasks:
+            try:
+                with open(f"{task_dir}/{task}/children") as f:
+                    pids.extend(int(c) for c in f.read().split())
+            except OSError:
+                pass
+        i += 1
+    return pids
+
+
+def find_nanamo(root, exe):
+    """Return the topmost process below root running exe, the browser"""
+    for pid in descendants(root):
+        try:
+            if os.readlink(f"/proc/{pid}/exe") == exe:
+                return pid
+        except OSError:
+            pass
+    return None
+
+
+def cpu_seconds(pid):
+    """Return user+system CPU time of pid, or None if it is gone"""
+    try:
+        with open(f"/proc/{pid}/stat") as f:
+            stat = f.read()
+    except OSError:
+        return None
+    # comm may contain spaces, fields are counted from after it
+    fields = stat[stat.rindex(")") + 2:].split()
+    return (int(fields[11]) + int(fields[12])) / CLK_TCK
+
+
+def summarize(stats_lines, warmup):
+    """Aggregate nanamo's --stats JSON lines past the warmup period"""
+    samples = [s for s in stats_lines if s["time"] > warmup]
+    elapsed = sum(s["interval"] for s in samples)
+    if not samples or elapsed <= 0:
+        return {}
+
+    paints = sum(s["paints"] for s in samples)
+    unchanged = sum(s.get("unchanged_paints", 0) for s in samples)
+    swaps = sum(s["swaps"] for s in samples)
+    upload = sum(s["upload_bytes"] for s in samples)
+    messages = sum(s.get("ingest_messages", 0) for s in samples)
+    ingested = sum(s.get("ingest_bytes", 0) for s in samples)
+
+    def weighted(name, key):
+        total = sum(s[name]["count"] for s in samples)
+        if not total:
+            return 0.0
+        return sum(s[name][key] * s[name]["count"] for s in samples) / total
+
+    interval_p50 = weighted("frame_interval", "p50_ns") / 1e6
+    interval_p99 = max(s["frame_interval"]["p99_ns"] for s in samples) / 1e6
+    result = {
+        "measured_seconds": elapsed,
+        "paints_per_sec": paints / elapsed,
+        "unchanged_paints_per_sec": unchanged / elapsed,
+        "swaps_per_sec": swaps / elapsed,
+        "upload_bytes": upload,
+        "upload_bytes_per_sec": upload / elapsed,
+        "paint_cpu_p50_ms": weighted("paint_cpu", "p50_ns") / 1e6,
+        "upload_latency_p50_ms": weighted("upload_latency", "p50_ns") / 1e6,
+        "frame_interval_p50_ms": interval_p50,
+        "frame_interval_p99_ms": interval_p99,
+        "frame_jitter_ms": interval_p99 - interval_p50,
+        "ingest_messages_per_sec": messages / elapsed,
+        "ingest_bytes_per_sec": ingested / elapsed,
+    }
+    # Only from --latency-probe
+    for name in ("input_to_paint", "input_to_upload", "input_to_present"):
+        if any(s.get(name, {}).get("count") for s in samples):
+            result[f"{name}_p50_ms"] = weighted(name, "p50_ns") / 1e6
+            result[f"{name}_p99_ms"] = max(
+                s[name]["p99_ns"] for s in samples) / 1e6
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--nanamo", required=True,
+                        help="installed nanamo executable")
+    parser.add_argument("--page", help="page to load")
+    parser.add_argument("--duration", type=float, default=20.0)
+    parser.add_argument("--warmup", type=float, default=3.0,
+                        help="seconds of statistics to discard")
+    parser.add_argument("--geometry", default="1280x720+0+0")
+    parser.add_argument("--xvfb", action="store_true",
+                        help="always run under xvfb-run")
+    parser.add_argument("--offscreen", action="store_true",
+                        help="draw offscreen through surfaceless EGL")
+    parser.add_argument("--output", help="also write results to this file")
+    parser.add_argument("--ingest", metavar="PRODUCER",
+                        help="nanamo-ingest executable to feed the page with")
+    parser.add_argument("--ingest-rate", type=int, default=100000,
+                        help="events per second the producer sends")
+    parser.add_argument("--ingest-size", type=int, default=32,
+                        help="bytes per event")
+    parser.add_argument("--latency-probe", type=int, metavar="CLICKS",
+                        help="measure input latency instead of a page")
+    parser.add_argument("extra", nargs="*", help="extra nanamo options")
+    args = parser.parse_args()
+
+    if not args.page and not args.latency_probe:
+        sys.exit("error: --page or --latency-probe is needed")
+    if args.latency_probe and (args.page or args.offscreen or args.ingest):
+        sys.exit("error: --latency-probe takes no page, and needs a window")
+
+    if args.offscreen and args.ingest:
+        sys.exit("error: --ingest needs windows, not --offscreen")
+
+    nanamo = os.path.abspath(args.nanamo)
+    page = os.path.abspath(args.page) if args.page else None
+    if not os.path.exists(nanamo):
+        sys.exit(f"error: {nanamo} not found, install nanamo first")
+
+    env = dict(os.environ)
+    env["LD_LIBRARY_PATH"] = os.path.dirname(nanamo)
+    env.setdefault("LIBGL_ALWAYS_SOFTWARE", "1")
+    env.setdefault("GALLIUM_DRIVER", "llvmpipe")
+
+    with tempfile.TemporaryDirectory(prefix="nanamo-bench-") as tmp:
+        stats_path = os.path.join(tmp, "stats.jsonl")
+        ingest_path = os.path.join(tmp, "ingest.sock")
+        cmd = [nanamo, "-t", "-g", args.geometry,
+               f"--stats={stats_path}", "--stats-interval=1",
+               f"--exit-after={args.duration}", *args.extra]
+        if page:
+            cmd.append("file://" + page)
+        else:
+            cmd.insert(1, f"--latency-probe={args.latency_probe}")
+        if args.ingest:
+            cmd.insert(1, f"--ingest={ingest_path}")
+        if args.offscreen:
+            cmd.insert(1, "--offscreen")
+
+        if not args.offscreen and (args.xvfb or not (
+                env.get("DISPLAY") or env.get("WAYLAND_DISPLAY"))):
+            if not shutil.which("xvfb-run"):
+                sys.exit("error: no display and xvfb-run not found")
+            cmd = ["xvfb-run", "-a", "-s", "-screen 0 1920x1080x24", *cmd]
+
+        proc = subprocess.Popen(cmd, env=env, cwd=os.path.dirname(nanamo))
+        producer = None
+
+        # CPU time is cumulative, keep the last value seen for each process.
+        # CEF helpers run the same executable, the browser process is the
+        # topmost one and everything below it counts as children.
+        pid = None
+        cpu = {}
+        while proc.poll() is None:
+            pid = pid or find_nanamo(proc.pid, os.path.realpath(nanamo))
+            if args.ingest and not producer and os.path.exists(ingest_path):
+                producer = subprocess.Popen(
+                    [args.ingest, f"--rate={args.ingest_rate}",
+                     f"--size={args.ingest_size}", ingest_path])
+            if pid:
+                for p in descendants(pid):
+                    seconds = cpu_seconds(p)
+                    if seconds is not None:
+                        cpu[p] = seconds
+            time.sleep(0.25)
+
+        if producer:
+            producer.terminate()
+            producer.wait()
+        if proc.returncode != 0:
+            sys.exit(f"error: nanamo exited with {proc.returncode}")
+
+        with open(stats_path) as f:
+            stats_lines = [json.loads(line) for line in f if line.strip()]
+
+    result = {
+        "page": os.path.basename(page) if page else "latency-probe",
+        "duration": args.duration,
+        "main_cpu_seconds": cpu.get(pid, 0.0),
+        "child_cpu_seconds": sum(v for k, v in cpu.items() if k != pid),
+    }
+    result.update(summarize(stats_lines, args.warmup))
+
+    text = json.dumps(result, indent=2, sort_keys=True)
+    print(text)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+
+
+if __name__ == "__main__":
+    main()
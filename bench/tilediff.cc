@@ -0,0 +1,124 @@
+/** tilediff.cc -- Microbenchmark of the damage shrinking kernels */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Times DamageShrinker::shrink() on a full-view dirty rect of a 1920x1080
+ * frame, with each kernel the CPU supports: when nothing changed (the whole
+ * frame is compared), when a few tiles changed, and when everything did
+ * (comparison stops early, the shadow copy is rewritten). Prints one JSON
+ * object, and writes it to the file given as argument too.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "damage.hh"
+
+using nanamo::DamageShrinker;
+
+static constexpr int WIDTH = 1920;
+static constexpr int HEIGHT = 1080;
+static constexpr double MIN_SECONDS = 0.5;
+
+/* Alternate between frames a and b, returning frame bytes per second */
+static double
+measure(DamageShrinker& shrinker, const std::vector<uint8_t>& a,
+        const std::vector<uint8_t>& b)
+{
+    using clock = std::chrono::steady_clock;
+    DamageShrinker::RectList dirty{CefRect(0, 0, WIDTH, HEIGHT)};
+    DamageShrinker::RectList out;
+    shrinker.shrink(dirty, a.data(), WIDTH, HEIGHT, out);
+
+    uint64_t frames = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+    do {
+        for (int i = 0; i < 16; i++, frames++) {
+            const auto& frame = frames % 2 ? a : b;
+            shrinker.shrink(dirty, frame.data(), WIDTH, HEIGHT, out);
+        }
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < MIN_SECONDS);
+    return frames * double(a.size()) / elapsed.count();
+}
+
+int
+main(int argc, char* argv[])
+{
+    std::vector<uint8_t> frame(size_t(WIDTH) * HEIGHT * 4);
+    std::mt19937 rng(7);
+    for (auto& byte : frame) {
+        byte = rng();
+    }
+
+    /* A blinking cursor and a ticking counter */
+    std::vector<uint8_t> sparse = frame;
+    for (int y = 500; y < 520; y++) {
+        sparse[(size_t(y) * WIDTH + 900) * 4] ^= 0xff;
+    }
+    for (int y = 40; y < 60; y++) {
+        for (int x = 1700; x < 1800; x++) {
+            sparse[(size_t(y) * WIDTH + x) * 4 + 1] ^= 0xff;
+        }
+    }
+
+    std::vector<uint8_t> changed = frame;
+    for (auto& byte : changed) {
+        byte = ~byte;
+    }
+
+    const DamageShrinker::Kernel kernels[] = {
+        DamageShrinker::Kernel::SCALAR,
+        DamageShrinker::Kernel::SSE41,
+        DamageShrinker::Kernel::AVX2,
+    };
+    std::ostringstream json;
+    json << "{\"width\":" << WIDTH << ",\"height\":" << HEIGHT;
+    for (auto kernel : kernels) {
+        if (!DamageShrinker::supported(kernel)) {
+            continue;
+        }
+        DamageShrinker shrinker(kernel);
+        json << ",\"" << DamageShrinker::kernelName(kernel) << "\":{"
+             << "\"unchanged_gb_per_sec\":"
+             << measure(shrinker, frame, frame) / 1e9
+             << ",\"sparse_gb_per_sec\":"
+             << measure(shrinker, frame, sparse) / 1e9
+             << ",\"changed_gb_per_sec\":"
+             << measure(shrinker, frame, changed) / 1e9 << "}";
+    }
+    json << "}";
+
+    std::cout << json.str() << std::endl;
+    if (argc > 1) {
+        std::ofstream(argv[1]) << json.str() << std::endl;
+    }
+    return 0;
+}
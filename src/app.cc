@@ -0,0 +1,140 @@
+/** app.cc -- CEF application implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <exception>
+#include <future>
+
+#include <cef_task.h>
+
+#include "app.hh"
+#include "bundle.hh"
+
+namespace nanamo {
+
+void
+App::OnBeforeCommandLineProcessing(const CefString& processType,
+                                   CefRefPtr<CefCommandLine> commandLine)
+{
+    if (!processType.empty()) {
+        /* Child processes get theirs from the browser process */
+        return;
+    }
+
+    if (m_profile) {
+        applyProfile(*m_profile, commandLine);
+    }
+    /* Later switches replace earlier ones with the same name */
+    for (const auto& [name, value] : m_switches) {
+        if (value.empty()) {
+            commandLine->AppendSwitch(name);
+        } else {
+            commandLine->AppendSwitchWithValue(name, value);
+        }
+    }
+}
+
+void
+App::OnRegisterCustomSchemes(CefRawPtr<CefSchemeRegistrar> registrar)
+{
+    /* Standard and secure, so pages in bundles get an origin of their own
+     * and may use fetch() and workers like over https */
+    registrar->AddCustomScheme(
+        BUNDLE_SCHEME, CEF_SCHEME_OPTION_STANDARD | CEF_SCHEME_OPTION_SECURE |
+                           CEF_SCHEME_OPTION_CORS_ENABLED |
+                           CEF_SCHEME_OPTION_FETCH_ENABLED);
+}
+
+CefRefPtr<CefBrowserProcessHandler>
+App::GetBrowserProcessHandler()
+{
+    return this;
+}
+
+CefRefPtr<CefRenderProcessHandler>
+App::GetRenderProcessHandler()
+{
+    return m_ingestReceiver;
+}
+
+void
+App::OnScheduleMessagePumpWork(int64_t delayMs)
+{
+    m_pump.schedule(delayMs);
+}
+
+MessagePump&
+App::pump()
+{
+    return m_pump;
+}
+
+void
+App::setProfile(Profile profile)
+{
+    m_profile = profile;
+}
+
+void
+App::addSwitch(const std::string& name, const std::string& value)
+{
+    m_switches.emplace_back(name, value);
+}
+
+class FunctionTask : public CefTask {
+  private:
+    std::function<void()> m_fn;
+
+  public:
+    explicit FunctionTask(std::function<void()> fn) : m_fn(std::move(fn)) {}
+
+    void Execute() override final
+    {
+        m_fn();
+    }
+
+    IMPLEMENT_REFCOUNTING(FunctionTask);
+};
+
+void
+runOnUiThread(const std::function<void()>& fn)
+{
+    if (CefCurrentlyOn(TID_UI)) {
+        fn();
+        return;
+    }
+
+    std::promise<void> done;
+    auto task = [&] {
+        try {
+            fn();
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    };
+    CefPostTask(TID_UI, new FunctionTask(task));
+    done.get_future().get();
+}
+
+} // namespace nanamo
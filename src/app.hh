@@ -0,0 +1,87 @@
+/** app.hh -- CEF application definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_APP_HH_
+#define NNM_APP_HH_
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cef_app.h>
+#include <cef_browser_process_handler.h>
+#include <cef_scheme.h>
+
+#include "ingest.hh"
+#include "profile.hh"
+#include "pump.hh"
+
+namespace nanamo {
+
+class App : public CefApp, public CefBrowserProcessHandler {
+  private:
+    MessagePump m_pump;
+    CefRefPtr<IngestReceiver> m_ingestReceiver = new IngestReceiver();
+
+    std::optional<Profile> m_profile;
+    std::vector<std::pair<std::string, std::string>> m_switches;
+
+  public:
+    void OnBeforeCommandLineProcessing(
+        const CefString& processType,
+        CefRefPtr<CefCommandLine> commandLine) override final;
+    /** Registers the bundle scheme, in every process */
+    void OnRegisterCustomSchemes(
+        CefRawPtr<CefSchemeRegistrar> registrar) override final;
+    CefRefPtr<CefBrowserProcessHandler>
+    GetBrowserProcessHandler() override final;
+    CefRefPtr<CefRenderProcessHandler>
+    GetRenderProcessHandler() override final;
+
+    void OnScheduleMessagePumpWork(int64_t delayMs) override final;
+
+    MessagePump& pump();
+
+    /** Use profile's switches, must be called before CefInitialize() */
+    void setProfile(Profile profile);
+    /**
+     * Pass a switch to Chromium, overriding the profile's. An empty value
+     * adds it without one.
+     */
+    void addSwitch(const std::string& name, const std::string& value);
+
+    IMPLEMENT_REFCOUNTING(App);
+};
+
+/**
+ * Run fn on CEF's UI thread and wait for it to finish, directly if this is
+ * that thread. Exceptions thrown by fn are passed on.
+ */
+void runOnUiThread(const std::function<void()>& fn);
+
+} // namespace nanamo
+
+#endif /* NNM_APP_HH_ */
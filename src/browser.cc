@@ -23,15 +23,19 @@
  */
 
 #include <iostream>
+#include <utility>
 
 #include <GL/glew.h>
 
 #include "browser.hh"
+#include "stats.hh"
+#include "trace.hh"
 
 namespace nanamo {
 
-BrowserRenderHandler::BrowserRenderHandler(int width, int height)
-    : m_width(width), m_height(height)
+BrowserRenderHandler::BrowserRenderHandler(int width, int height,
+                                           float scale)
+    : m_width(width), m_height(height), m_scale(scale)
 {
 }
 
@@ -41,18 +45,136 @@ BrowserRenderHandler::GetViewRect(CefRefPtr<CefBrowser>, CefRect& rect)
     rect = CefRect(0, 0, m_width, m_height);
 }
 
+bool
+BrowserRenderHandler::GetScreenInfo(CefRefPtr<CefBrowser>, CefScreenInfo& info)
+{
+    /* Layout and input stay in view coordinates, only the paint buffer is
+     * scaled */
+    info.device_scale_factor = m_scale;
+    info.rect = CefRect(0, 0, m_width, m_height);
+    info.available_rect = info.rect;
+    return true;
+}
+
 void
-BrowserRenderHandler::OnPaint(CefRefPtr<CefBrowser>, PaintElementType,
-                              const RectList&, const void* data, int width,
-                              int height)
+BrowserRenderHandler::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type,
+                              const RectList& dirtyRects, const void* data,
+                              int width, int height)
 {
     if (!data || width <= 0 || height <= 0) {
         /* skip */
         return;
     }
+    if (type != PET_VIEW) {
+        /* Popups are not composited yet, and their buffer would clobber the
+         * view texture. */
+        return;
+    }
+
+    std::unique_lock guard(m_paintLock);
+    if (m_closed) {
+        /* Browser is shutting down, GL resources are gone */
+        return;
+    }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA,
-                 GL_UNSIGNED_BYTE, data);
+    if (m_onFirstPaint) {
+        std::exchange(m_onFirstPaint, nullptr)();
+    }
+
+    TraceSpan span("OnPaint");
+    Stats* stats = Stats::get();
+    int64_t start = stats ? Stats::now() : 0;
+
+    const RectList* rects = &dirtyRects;
+    if (m_shrinker) {
+        m_shrinker->shrink(dirtyRects, data, width, height, m_shrunk);
+        rects = &m_shrunk;
+    }
+    if (rects->empty()) {
+        /* Not a pixel changed, nobody needs to hear about it */
+        if (stats) {
+            stats->paintCpu.record(Stats::now() - start);
+            stats->paints++;
+            stats->unchangedPaints++;
+        }
+        return;
+    }
+
+    if (m_probe) {
+        m_probe->painted(data, width, height);
+    }
+    if (m_mailbox) {
+        m_mailbox->write(*rects, data, width, height);
+    } else {
+        m_present(*rects, data, width, height);
+    }
+    if (m_exporter) {
+        m_exporter->publish(*rects, data, width, height);
+    }
+    if (m_recorder) {
+        m_recorder->record(*rects, data, width, height);
+    }
+
+    if (stats) {
+        stats->paintCpu.record(Stats::now() - start);
+        stats->paints++;
+    }
+    if (m_mailbox) {
+        m_notify();
+    }
+}
+
+void
+BrowserRenderHandler::m_present(const RectList& dirtyRects, const void* data,
+                                int width, int height)
+{
+    if (m_upload) {
+        TraceSpan span("upload");
+        m_uploader.upload(dirtyRects, data, width, height);
+        if (m_probe) {
+            m_probe->uploaded();
+        }
+    }
+    if (m_hitMask) {
+        m_hitMask->update(dirtyRects, data, width, height);
+    }
+
+    if (width != m_frameWidth || height != m_frameHeight) {
+        m_frameWidth = width;
+        m_frameHeight = height;
+        m_damageFull = true;
+    }
+    if (!m_damageFull) {
+        m_damage.insert(m_damage.end(), dirtyRects.begin(), dirtyRects.end());
+        m_damageFull = m_damage.size() > MAX_DAMAGE;
+    }
+    m_painted = true;
+}
+
+bool
+BrowserRenderHandler::frameReady() const
+{
+    return m_mailbox && m_mailbox->ready();
+}
+
+void
+BrowserRenderHandler::takeFrame()
+{
+    if (!m_mailbox || m_closed) {
+        return;
+    }
+
+    bool full;
+    const FrameMailbox::Frame* frame = m_mailbox->read(full);
+    if (!frame) {
+        return;
+    }
+    if (full) {
+        /* Frames were skipped, their changes are not in frame->rects */
+        m_fullFrame.assign(1, CefRect(0, 0, frame->width, frame->height));
+    }
+    m_present(full ? m_fullFrame : frame->rects, frame->pixels.data(),
+              frame->width, frame->height);
 }
 
 void
@@ -62,8 +184,102 @@ BrowserRenderHandler::resize(int width, int height)
     m_height = height;
 }
 
-BrowserClient::BrowserClient(CefRefPtr<BrowserRenderHandler> rh)
-    : m_renderHandler(rh)
+void
+BrowserRenderHandler::onFirstPaint(std::function<void()> fn)
+{
+    m_onFirstPaint = std::move(fn);
+}
+
+void
+BrowserRenderHandler::enableLatencyProbe(LatencyProbe& probe)
+{
+    m_probe = &probe;
+}
+
+void
+BrowserRenderHandler::enableDamageShrinking()
+{
+    m_shrinker.emplace();
+}
+
+void
+BrowserRenderHandler::enableHitMask(uint8_t threshold)
+{
+    m_hitMask.emplace(threshold);
+}
+
+HitMask*
+BrowserRenderHandler::hitMask()
+{
+    return m_hitMask ? &*m_hitMask : nullptr;
+}
+
+void
+BrowserRenderHandler::enableExport(const std::string& socketPath)
+{
+    m_exporter = std::make_unique<FrameExporter>(socketPath);
+}
+
+void
+BrowserRenderHandler::enableRecording(const std::string& path)
+{
+    m_recorder = std::make_unique<FrameRecorder>(path);
+}
+
+void
+BrowserRenderHandler::disableUpload()
+{
+    m_upload = false;
+}
+
+void
+BrowserRenderHandler::enableMailbox(std::function<void()> notify)
+{
+    m_mailbox = std::make_unique<FrameMailbox>();
+    m_notify = std::move(notify);
+}
+
+bool
+BrowserRenderHandler::takePainted()
+{
+    return m_painted.exchange(false);
+}
+
+bool
+BrowserRenderHandler::takeDamage(RectList& rects, int& width, int& height)
+{
+    bool full = m_damageFull;
+    rects.swap(m_damage);
+    m_damage.clear();
+    m_damageFull = false;
+    width = m_frameWidth;
+    height = m_frameHeight;
+    return full;
+}
+
+GLuint
+BrowserRenderHandler::texture(int& width, int& height) const
+{
+    width = m_uploader.width();
+    height = m_uploader.height();
+    return m_uploader.texture();
+}
+
+void
+BrowserRenderHandler::close()
+{
+    std::unique_lock guard(m_paintLock);
+    m_uploader.release();
+    m_exporter.reset();
+    m_recorder.reset();
+    m_closed = true;
+}
+
+std::atomic<int> BrowserClient::s_open = 0;
+
+BrowserClient::BrowserClient(CefRefPtr<BrowserRenderHandler> rh,
+                             std::function<void()> notify)
+    : m_renderHandler(rh), m_notify(std::move(notify))
 {
 }
 
@@ -73,4 +289,74 @@ BrowserClient::GetRenderHandler()
     return m_renderHandler;
 }
 
+CefRefPtr<CefLifeSpanHandler>
+BrowserClient::GetLifeSpanHandler()
+{
+    return this;
+}
+
+void
+BrowserClient::OnAfterCreated(CefRefPtr<CefBrowser> browser)
+{
+    {
+        std::unique_lock guard(m_lock);
+        if (m_closed) {
+            /* The owner went away while the browser was being created */
+            browser->GetHost()->CloseBrowser(true);
+            return;
+        }
+        m_browser = browser;
+    }
+    if (m_notify) {
+        m_notify();
+    }
+}
+
+void
+BrowserClient::OnBeforeClose(CefRefPtr<CefBrowser>)
+{
+    s_open--;
+}
+
+bool
+BrowserClient::create(const CefWindowInfo& windowInfo, const std::string& url,
+                      const CefBrowserSettings& settings)
+{
+    if (!CefBrowserHost::CreateBrowser(windowInfo, this, url, settings,
+                                       nullptr, nullptr)) {
+        return false;
+    }
+    s_open++;
+    return true;
+}
+
+CefRefPtr<CefBrowser>
+BrowserClient::takeBrowser()
+{
+    std::unique_lock guard(m_lock);
+    if (m_taken || !m_browser) {
+        return nullptr;
+    }
+    m_taken = true;
+    return m_browser;
+}
+
+void
+BrowserClient::close()
+{
+    std::unique_lock guard(m_lock);
+    m_closed = true;
+    if (m_browser) {
+        m_browser->GetHost()->CloseBrowser(true);
+        /* The browser holds on to us, don't hold on to it */
+        m_browser = nullptr;
+    }
+}
+
+int
+BrowserClient::openBrowsers()
+{
+    return s_open;
+}
+
 } // namespace nanamo
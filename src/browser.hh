@@ -26,35 +26,175 @@
 #define NNM_RENDER_HANDLER_HH_
 
 #include <cef_client.h>
+#include <cef_life_span_handler.h>
 #include <cef_render_handler.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "damage.hh"
+#include "export.hh"
+#include "hitmask.hh"
+#include "mailbox.hh"
+#include "probe.hh"
+#include "record.hh"
+#include "upload.hh"
+
 namespace nanamo {
 
 class BrowserRenderHandler : public CefRenderHandler {
   private:
-    int m_width = 0;
-    int m_height = 0;
+    /* Set from the render loop, read from CEF's UI thread */
+    std::atomic<int> m_width = 0;
+    std::atomic<int> m_height = 0;
+    float m_scale = 1.0f;
+
+    std::optional<DamageShrinker> m_shrinker;
+    RectList m_shrunk;
+
+    TextureUploader m_uploader;
+    bool m_upload = true;
+    std::optional<HitMask> m_hitMask;
+    std::unique_ptr<FrameExporter> m_exporter;
+    std::unique_ptr<FrameRecorder> m_recorder;
+
+    std::unique_ptr<FrameMailbox> m_mailbox;
+    std::function<void()> m_notify;
+    CefRenderHandler::RectList m_fullFrame;
+
+    std::function<void()> m_onFirstPaint;
+    LatencyProbe* m_probe = nullptr;
+
+    /* Keeps close() from racing a paint on another thread */
+    std::mutex m_paintLock;
+    std::atomic<bool> m_painted = false;
+    bool m_closed = false;
+
+    /* Painted rects not yet taken by takeDamage() */
+    static constexpr size_t MAX_DAMAGE = 64;
+    RectList m_damage;
+    bool m_damageFull = true;
+    int m_frameWidth = 0;
+    int m_frameHeight = 0;
+
+    void m_present(const RectList&, const void* data, int width, int height);
 
   public:
-    BrowserRenderHandler(int width, int height);
+    /**
+     * The view is laid out at width x height, in window coordinates, and
+     * painted at scale times that many pixels
+     */
+    BrowserRenderHandler(int width, int height, float scale = 1.0f);
 
     void GetViewRect(CefRefPtr<CefBrowser>, CefRect&) override final;
+    bool GetScreenInfo(CefRefPtr<CefBrowser>, CefScreenInfo&) override final;
     void OnPaint(CefRefPtr<CefBrowser>, PaintElementType, const RectList&,
                  const void*, int width, int height) override final;
 
     void resize(int width, int height);
 
+    /**
+     * Shrink painted rects to the tiles whose pixels changed, and drop
+     * paints that changed nothing, see DamageShrinker
+     */
+    void enableDamageShrinking();
+    /** Call fn on the first paint, on the thread paints arrive on */
+    void onFirstPaint(std::function<void()> fn);
+    /** Show every paint and upload to probe, which must outlive close() */
+    void enableLatencyProbe(LatencyProbe& probe);
+    /** Track which pixels have alpha above threshold from now on */
+    void enableHitMask(uint8_t threshold);
+    /** The hit-test mask, or null if not enabled */
+    HitMask* hitMask();
+
+    /** Publish every paint for other processes, see FrameExporter */
+    void enableExport(const std::string& socketPath);
+    /** Write every paint to a file, see FrameRecorder */
+    void enableRecording(const std::string& path);
+    /** Stop uploading paints to a texture, for use without GL */
+    void disableUpload();
+    /**
+     * Leave paints in a mailbox for takeFrame() instead of uploading them
+     * in OnPaint, for when CEF runs on a thread of its own. notify is
+     * called after every paint.
+     */
+    void enableMailbox(std::function<void()> notify);
+
+    /** Whether the mailbox holds a frame takeFrame() would upload */
+    bool frameReady() const;
+    /** Upload the latest frame from the mailbox, if there is a new one */
+    void takeFrame();
+
+    /** Whether a paint was uploaded since the last call */
+    bool takePainted();
+    /**
+     * Move the rects uploaded since the last call to rects, and set width
+     * and height to the painted frame's size. Returns true if all of it
+     * changed, in which case rects is not meaningful.
+     */
+    bool takeDamage(RectList& rects, int& width, int& height);
+
+    /**
+     * Texture holding the last painted frame in its top-left width x height
+     * texels, 0 before the first paint
+     */
+    GLuint texture(int& width, int& height) const;
+    /**
+     * Free GL resources and ignore any later paints, must be called while
+     * the shared context is current
+     */
+    void close();
+
     IMPLEMENT_REFCOUNTING(BrowserRenderHandler);
 };
 
-class BrowserClient : public CefClient {
+/**
+ * Client of a browser created with CefBrowserHost::CreateBrowser().
+ *
+ * The browser arrives later on CEF's UI thread, whichever thread the owner
+ * runs on; the owner picks it up with takeBrowser(). Browsers count as open
+ * from create() until CEF has closed them, which it must have done for all
+ * of them before CefShutdown().
+ */
+class BrowserClient : public CefClient, public CefLifeSpanHandler {
   private:
+    static std::atomic<int> s_open;
+
     CefRefPtr<BrowserRenderHandler> m_renderHandler;
+    std::function<void()> m_notify;
+
+    std::mutex m_lock;
+    CefRefPtr<CefBrowser> m_browser;
+    bool m_taken = false;
+    bool m_closed = false;
 
   public:
-    BrowserClient(CefRefPtr<BrowserRenderHandler>);
+    /** notify is called once the browser was created, on CEF's UI thread */
+    BrowserClient(CefRefPtr<BrowserRenderHandler>,
+                  std::function<void()> notify = nullptr);
 
     CefRefPtr<CefRenderHandler> GetRenderHandler() override final;
+    CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override final;
+
+    void OnAfterCreated(CefRefPtr<CefBrowser>) override final;
+    void OnBeforeClose(CefRefPtr<CefBrowser>) override final;
+
+    /** Start creating the browser, false if CEF refused to */
+    bool create(const CefWindowInfo&, const std::string& url,
+                const CefBrowserSettings&);
+    /** The browser once created, returned by one call only */
+    CefRefPtr<CefBrowser> takeBrowser();
+    /** Close the browser, now or as soon as it is created */
+    void close();
+
+    /** Browsers created and not closed yet, by any client */
+    static int openBrowsers();
 
     IMPLEMENT_REFCOUNTING(BrowserClient);
 };
@@ -0,0 +1,269 @@
+/** bundle.cc -- Asset bundle scheme handler implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bundle.hh"
+#include "socket.hh"
+
+namespace nanamo {
+
+/* Whether [offset, offset + size) lies within a file of fileSize bytes */
+static bool
+inBounds(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+Bundle::Bundle(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw systemError(path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        auto error = systemError(path);
+        close(fd);
+        throw error;
+    }
+    m_size = st.st_size;
+    if (m_size < sizeof(BundleHeader)) {
+        close(fd);
+        throw std::runtime_error(path + " is not a bundle");
+    }
+
+    void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* The mapping keeps the file */
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw systemError(path);
+    }
+    m_data = static_cast<const uint8_t*>(mapped);
+    /* Start reading it in before the first request needs it */
+    madvise(mapped, m_size, MADV_WILLNEED);
+
+    const auto* header = reinterpret_cast<const BundleHeader*>(m_data);
+    if (std::memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) ||
+        header->version != BUNDLE_VERSION ||
+        header->entryCount >
+            (m_size - sizeof(BundleHeader)) / sizeof(BundleEntry)) {
+        munmap(mapped, m_size);
+        throw std::runtime_error(path + " is not a bundle");
+    }
+    m_entries = reinterpret_cast<const BundleEntry*>(header + 1);
+    m_count = header->entryCount;
+
+    /* Lookups index and binary search without further checks */
+    for (size_t i = 0; i < m_count; i++) {
+        const BundleEntry& entry = m_entries[i];
+        bool valid =
+            inBounds(entry.pathOffset, entry.pathSize, m_size) &&
+            inBounds(entry.mimeOffset, entry.mimeSize, m_size) &&
+            inBounds(entry.dataOffset, entry.dataSize, m_size) &&
+            (i == 0 || m_string(m_entries[i - 1].pathOffset,
+                                m_entries[i - 1].pathSize) <
+                           m_string(entry.pathOffset, entry.pathSize));
+        if (!valid) {
+            munmap(mapped, m_size);
+            throw std::runtime_error(path + " is corrupt");
+        }
+    }
+}
+
+Bundle::~Bundle()
+{
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+std::string_view
+Bundle::m_string(uint64_t offset, uint32_t size) const
+{
+    return {reinterpret_cast<const char*>(m_data + offset), size};
+}
+
+size_t
+Bundle::size() const
+{
+    return m_count;
+}
+
+bool
+Bundle::find(std::string_view path, File& file) const
+{
+    const BundleEntry* end = m_entries + m_count;
+    const BundleEntry* entry = std::lower_bound(
+        m_entries, end, path, [this](const BundleEntry& e, std::string_view p) {
+            return m_string(e.pathOffset, e.pathSize) < p;
+        });
+    if (entry == end || m_string(entry->pathOffset, entry->pathSize) != path) {
+        return false;
+    }
+    file.data = m_data + entry->dataOffset;
+    file.size = entry->dataSize;
+    file.mime = m_string(entry->mimeOffset, entry->mimeSize);
+    return true;
+}
+
+static int
+hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* The path in the bundle that url asks for, decoded */
+static std::string
+bundlePath(const std::string& url)
+{
+    size_t start = url.find("://");
+    start = start == url.npos ? 0 : url.find('/', start + 3);
+    if (start == url.npos) {
+        return "index.html";
+    }
+    size_t end = url.find_first_of("?#", start);
+    std::string_view raw(url);
+    raw = raw.substr(start + 1, end == url.npos ? url.npos : end - start - 1);
+
+    std::string path;
+    for (size_t i = 0; i < raw.size(); i++) {
+        int high, low;
+        if (raw[i] == '%' && i + 2 < raw.size() &&
+            (high = hexDigit(raw[i + 1])) >= 0 &&
+            (low = hexDigit(raw[i + 2])) >= 0) {
+            path += char(high << 4 | low);
+            i += 2;
+        } else {
+            path += raw[i];
+        }
+    }
+    if (path.empty() || path.back() == '/') {
+        path += "index.html";
+    }
+    return path;
+}
+
+BundleResourceHandler::BundleResourceHandler(
+    std::shared_ptr<const Bundle> bundle)
+    : m_bundle(std::move(bundle))
+{
+}
+
+bool
+BundleResourceHandler::Open(CefRefPtr<CefRequest> request,
+                            bool& handleRequest, CefRefPtr<CefCallback>)
+{
+    /* Everything is in memory already, answer right away */
+    handleRequest = true;
+    m_found = m_bundle->find(bundlePath(request->GetURL().ToString()), m_file);
+    return true;
+}
+
+void
+BundleResourceHandler::GetResponseHeaders(CefRefPtr<CefResponse> response,
+                                          int64_t& length, CefString&)
+{
+    if (!m_found) {
+        response->SetError(ERR_FILE_NOT_FOUND);
+        response->SetStatus(404);
+        response->SetStatusText("Not Found");
+        length = 0;
+        return;
+    }
+    response->SetStatus(200);
+    response->SetStatusText("OK");
+    response->SetMimeType(std::string(m_file.mime));
+    length = m_file.size;
+}
+
+bool
+BundleResourceHandler::Skip(int64_t bytes, int64_t& skipped,
+                            CefRefPtr<CefResourceSkipCallback>)
+{
+    size_t n = std::min<size_t>(bytes, m_file.size - m_offset);
+    m_offset += n;
+    skipped = n;
+    return true;
+}
+
+bool
+BundleResourceHandler::Read(void* out, int bytes, int& read,
+                            CefRefPtr<CefResourceReadCallback>)
+{
+    /* The one copy there is, from the mapping into Chromium's buffer */
+    size_t n = std::min<size_t>(bytes, m_file.size - m_offset);
+    std::memcpy(out, m_file.data + m_offset, n);
+    m_offset += n;
+    read = n;
+    return n > 0;
+}
+
+void
+BundleResourceHandler::Cancel()
+{
+}
+
+BundleSchemeHandlerFactory::BundleSchemeHandlerFactory(
+    std::shared_ptr<const Bundle> bundle)
+    : m_bundle(std::move(bundle))
+{
+}
+
+CefRefPtr<CefResourceHandler>
+BundleSchemeHandlerFactory::Create(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+                                   const CefString&, CefRefPtr<CefRequest>)
+{
+    return new BundleResourceHandler(m_bundle);
+}
+
+std::string
+serveBundle(const std::string& path)
+{
+    auto bundle = std::make_shared<const Bundle>(path);
+    /* Hosts of standard schemes arrive lowercased */
+    std::string name = std::filesystem::path(path).stem().string();
+    std::ranges::transform(name, name.begin(), [](unsigned char c) {
+        return std::tolower(c);
+    });
+    if (!CefRegisterSchemeHandlerFactory(
+            BUNDLE_SCHEME, name, new BundleSchemeHandlerFactory(bundle))) {
+        throw std::runtime_error("Failed to serve " + path + " as " +
+                                 BUNDLE_SCHEME + "://" + name);
+    }
+    return name;
+}
+
+} // namespace nanamo
@@ -0,0 +1,128 @@
+/** bundle.hh -- Asset bundle scheme handler definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_BUNDLE_HH_
+#define NNM_BUNDLE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <cef_resource_handler.h>
+#include <cef_scheme.h>
+
+#include "bundlefmt.hh"
+
+namespace nanamo {
+
+/** Scheme that bundles are served under, see serveBundle() */
+static constexpr const char* BUNDLE_SCHEME = "nanamo";
+
+/**
+ * An asset bundle, see bundlefmt.hh, mapped read-only for the lifetime of
+ * the object. Every entry is checked when it is opened, so lookups can
+ * trust the index.
+ */
+class Bundle {
+  public:
+    struct File {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::string_view mime;
+    };
+
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    const BundleEntry* m_entries = nullptr;
+    size_t m_count = 0;
+
+    std::string_view m_string(uint64_t offset, uint32_t size) const;
+
+  public:
+    /** Map the bundle at path, throwing if it can't or it is corrupt */
+    explicit Bundle(const std::string& path);
+    ~Bundle();
+
+    Bundle(const Bundle&) = delete;
+    Bundle& operator=(const Bundle&) = delete;
+
+    size_t size() const;
+    /** Look up a file by its path in the bundle, false if there is none */
+    bool find(std::string_view path, File& file) const;
+};
+
+/**
+ * Serves one request from a bundle, straight out of its mapping. Paths
+ * ending in '/' get their index.html.
+ */
+class BundleResourceHandler : public CefResourceHandler {
+  private:
+    std::shared_ptr<const Bundle> m_bundle;
+    Bundle::File m_file;
+    bool m_found = false;
+    size_t m_offset = 0;
+
+  public:
+    explicit BundleResourceHandler(std::shared_ptr<const Bundle> bundle);
+
+    bool Open(CefRefPtr<CefRequest>, bool& handleRequest,
+              CefRefPtr<CefCallback>) override final;
+    void GetResponseHeaders(CefRefPtr<CefResponse>, int64_t& length,
+                            CefString& redirectUrl) override final;
+    bool Skip(int64_t bytes, int64_t& skipped,
+              CefRefPtr<CefResourceSkipCallback>) override final;
+    bool Read(void* out, int bytes, int& read,
+              CefRefPtr<CefResourceReadCallback>) override final;
+    void Cancel() override final;
+
+    IMPLEMENT_REFCOUNTING(BundleResourceHandler);
+};
+
+class BundleSchemeHandlerFactory : public CefSchemeHandlerFactory {
+  private:
+    std::shared_ptr<const Bundle> m_bundle;
+
+  public:
+    explicit BundleSchemeHandlerFactory(std::shared_ptr<const Bundle> bundle);
+
+    CefRefPtr<CefResourceHandler> Create(CefRefPtr<CefBrowser>,
+                                         CefRefPtr<CefFrame>,
+                                         const CefString& scheme,
+                                         CefRefPtr<CefRequest>) override final;
+
+    IMPLEMENT_REFCOUNTING(BundleSchemeHandlerFactory);
+};
+
+/**
+ * Serve the bundle at path as nanamo://NAME/, where NAME is its file name
+ * without extension, and return NAME. Must be called after CefInitialize().
+ */
+std::string serveBundle(const std::string& path);
+
+} // namespace nanamo
+
+#endif /* NNM_BUNDLE_HH_ */
@@ -0,0 +1,62 @@
+/** bundlefmt.hh -- Asset bundle file format definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_BUNDLEFMT_HH_
+#define NNM_BUNDLEFMT_HH_
+
+#include <cstdint>
+
+/*
+ * A bundle is a BundleHeader, entryCount BundleEntries sorted by path, then
+ * the strings and file contents the entries point at, in host byte order.
+ * Offsets are from the start of the file and strings are not terminated.
+ * Paths are relative to the packed directory, with '/' separators and no
+ * leading slash, and compare bytewise. Contents start at multiples of
+ * BUNDLE_ALIGN, so they can be served straight from a mapping.
+ */
+
+namespace nanamo {
+
+static constexpr char BUNDLE_MAGIC[4] = {'N', 'N', 'M', 'B'};
+static constexpr uint32_t BUNDLE_VERSION = 1;
+static constexpr uint64_t BUNDLE_ALIGN = 64;
+
+struct BundleHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t entryCount;
+};
+
+struct BundleEntry {
+    uint64_t pathOffset;
+    uint64_t mimeOffset;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint32_t pathSize;
+    uint32_t mimeSize;
+};
+
+} // namespace nanamo
+
+#endif /* NNM_BUNDLEFMT_HH_ */
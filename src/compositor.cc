@@ -0,0 +1,169 @@
+/** compositor.cc -- Overlay drawing implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "compositor.hh"
+#include "renderer.hh"
+#include "trace.hh"
+
+namespace nanamo {
+
+Compositor::Compositor(RenderContext& context, Surface& surface,
+                       CefRefPtr<BrowserRenderHandler> renderHandler,
+                       float sharpness)
+    : m_context(context), m_surface(surface),
+      m_renderHandler(renderHandler), m_sharpness(sharpness)
+{
+    /* Vertex arrays are not shared between contexts */
+    m_surface.makeCurrent();
+    glGenVertexArrays(1, &m_vertexArray);
+}
+
+Compositor::~Compositor()
+{
+    m_surface.makeCurrent();
+    if (m_drawTimer) {
+        m_drawTimer->release();
+    }
+    glDeleteVertexArrays(1, &m_vertexArray);
+}
+
+void
+Compositor::m_collectDamage(int width, int height)
+{
+    int frameWidth, frameHeight;
+    bool full = m_renderHandler->takeDamage(m_paintDamage, frameWidth,
+                                            frameHeight);
+    m_damage.clear();
+    if (m_needsRedraw || full || frameWidth <= 0 || frameHeight <= 0) {
+        m_damage.emplace_back(0, 0, width, height);
+        return;
+    }
+
+    /* Filtering reads the texels next to a changed one, and sharpening
+     * their neighbours too */
+    int pad = m_sharpness > 0.0f ? 2 : 1;
+    double scaleX = double(width) / frameWidth;
+    double scaleY = double(height) / frameHeight;
+    for (const auto& rect : m_paintDamage) {
+        int x0 = std::max(0, int(std::floor((rect.x - pad) * scaleX)));
+        int y0 = std::max(0, int(std::floor((rect.y - pad) * scaleY)));
+        int x1 = std::min(
+            width, int(std::ceil((rect.x + rect.width + pad) * scaleX)));
+        int y1 = std::min(
+            height, int(std::ceil((rect.y + rect.height + pad) * scaleY)));
+        if (x0 < x1 && y0 < y1) {
+            /* Paints are top-down, the framebuffer bottom-up */
+            m_damage.emplace_back(x0, height - y1, x1 - x0, y1 - y0);
+        }
+    }
+}
+
+void
+Compositor::m_render()
+{
+    TraceSpan span("render");
+    int width, height;
+    GLuint texture = m_renderHandler->texture(width, height);
+    if (!texture) {
+        /* Nothing painted yet */
+        return;
+    }
+
+    glBindVertexArray(m_vertexArray);
+    m_context.drawQuad(texture, width, height, m_sharpness);
+}
+
+void
+Compositor::invalidate()
+{
+    m_needsRedraw = true;
+}
+
+bool
+Compositor::frame(bool painted)
+{
+    if (!painted && !m_needsRedraw) {
+        return false;
+    }
+
+    int width, height;
+    m_surface.makeCurrent();
+    m_surface.size(width, height);
+    m_collectDamage(width, height);
+    m_needsRedraw = false;
+    if (m_damage.empty()) {
+        return false;
+    }
+    bool partial = m_surface.begin(width, height, m_damage, m_redraw);
+    glViewport(0, 0, width, height);
+
+    Stats* stats = Stats::get();
+    if (stats && !m_drawTimer) {
+        m_drawTimer.emplace(stats->drawGpu);
+    }
+    if (m_drawTimer) {
+        m_drawTimer->begin();
+    }
+
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    if (partial) {
+        /* The rest of the framebuffer still holds the current frame */
+        glEnable(GL_SCISSOR_TEST);
+        for (const auto& rect : m_redraw) {
+            glScissor(rect.x, rect.y, rect.width, rect.height);
+            glClear(GL_COLOR_BUFFER_BIT);
+            m_render();
+        }
+        glDisable(GL_SCISSOR_TEST);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT);
+        m_render();
+    }
+
+    if (m_drawTimer) {
+        m_drawTimer->end();
+    }
+    {
+        TraceSpan span("swap");
+        m_surface.present();
+    }
+
+    if (stats) {
+        int64_t now = Stats::now();
+        if (m_lastSwap) {
+            stats->frameInterval.record(now - m_lastSwap);
+        }
+        m_lastSwap = now;
+        stats->swaps++;
+        if (partial) {
+            stats->partialSwaps++;
+        }
+    }
+    return true;
+}
+
+} // namespace nanamo
@@ -0,0 +1,86 @@
+/** compositor.hh -- Overlay drawing definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_COMPOSITOR_HH_
+#define NNM_COMPOSITOR_HH_
+
+#include <cstdint>
+#include <optional>
+
+#include <GL/glew.h>
+
+#include "browser.hh"
+#include "present.hh"
+#include "stats.hh"
+#include "surface.hh"
+
+namespace nanamo {
+
+class RenderContext;
+
+/**
+ * Draws an overlay's frame texture onto its surface, redrawing only the
+ * parts paints changed where the surface allows. The same path serves
+ * windows and offscreen overlays.
+ */
+class Compositor {
+  private:
+    RenderContext& m_context;
+    Surface& m_surface;
+    CefRefPtr<BrowserRenderHandler> m_renderHandler;
+    float m_sharpness;
+
+    GLuint m_vertexArray;
+
+    bool m_needsRedraw = true;
+    CefRenderHandler::RectList m_paintDamage;
+    Presenter::Region m_damage;
+    Presenter::Region m_redraw;
+
+    std::optional<GpuTimer> m_drawTimer;
+    int64_t m_lastSwap = 0;
+
+    void m_collectDamage(int width, int height);
+    void m_render();
+
+  public:
+    Compositor(RenderContext&, Surface&, CefRefPtr<BrowserRenderHandler>,
+               float sharpness);
+    ~Compositor();
+
+    Compositor(const Compositor&) = delete;
+    Compositor& operator=(const Compositor&) = delete;
+
+    /** Redraw the whole surface in the next frame */
+    void invalidate();
+    /**
+     * Draw and present if painted, or invalidated since the last frame.
+     * Returns whether a frame was presented.
+     */
+    bool frame(bool painted);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_COMPOSITOR_HH_ */
@@ -0,0 +1,280 @@
+/** daemon.cc -- Overlay daemon implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "daemon.hh"
+#include "socket.hh"
+
+namespace nanamo {
+
+Daemon::Connection::Connection(int fd) : fd(fd)
+{
+}
+
+Daemon::Connection::~Connection()
+{
+    close(fd);
+}
+
+Daemon::Daemon(const std::string& path, const RendererOptions& defaults,
+               RenderContext& context, MessagePump& pump)
+    : m_path(path), m_defaults(defaults), m_context(context), m_pump(pump)
+{
+    m_listenFd = listenUnix(path, SOCK_STREAM);
+
+    m_stopFd = eventfd(0, EFD_CLOEXEC);
+    if (m_stopFd < 0) {
+        auto error = systemError("eventfd");
+        close(m_listenFd);
+        throw error;
+    }
+
+    m_thread = std::thread(&Daemon::m_serve, this);
+}
+
+Daemon::~Daemon()
+{
+    uint64_t one = 1;
+    if (write(m_stopFd, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "Failed to stop daemon thread" << std::endl;
+        std::abort();
+    }
+    m_thread.join();
+
+    close(m_stopFd);
+    close(m_listenFd);
+    unlink(m_path.c_str());
+}
+
+bool
+Daemon::m_read(const std::shared_ptr<Connection>& connection)
+{
+    char buf[4096];
+    ssize_t len = read(connection->fd, buf, sizeof(buf));
+    if (len <= 0) {
+        return len < 0 && errno == EINTR;
+    }
+
+    std::string& input = connection->input;
+    input.append(buf, len);
+
+    size_t start = 0;
+    size_t end;
+    bool queued = false;
+    while ((end = input.find('\n', start)) != std::string::npos) {
+        std::unique_lock guard(m_lock);
+        m_requests.push_back({connection, input.substr(start, end - start)});
+        start = end + 1;
+        queued = true;
+    }
+    input.erase(0, start);
+
+    if (queued) {
+        m_pump.wake();
+    }
+    return input.size() <= MAX_LINE;
+}
+
+void
+Daemon::m_serve()
+{
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+
+    for (;;) {
+        fds.clear();
+        fds.push_back({m_stopFd, POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (const auto& connection : connections) {
+            fds.push_back({connection->fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Daemon stopped: " << std::strerror(errno)
+                      << std::endl;
+            return;
+        }
+        if (fds[0].revents) {
+            return;
+        }
+
+        /* Connections stay open while the main loop still has to answer
+         * their requests, those hold a reference */
+        for (size_t i = connections.size(); i-- > 0;) {
+            if (fds[i + 2].revents && !m_read(connections[i])) {
+                connections.erase(connections.begin() + i);
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                connections.push_back(std::make_shared<Connection>(fd));
+            }
+        }
+    }
+}
+
+static std::string
+failure(const std::string& msg)
+{
+    return "error " + msg + "\n";
+}
+
+std::string
+Daemon::m_execute(MainLoop& loop, const std::string& line)
+{
+    std::istringstream in(line);
+    std::string command;
+    in >> command;
+
+    if (command == "open") {
+        RendererOptions opts = m_defaults;
+        if (!(in >> opts.url)) {
+            return failure("usage: open URL [WxH[+X+Y]] [border] "
+                           "[resizable] [transparent]");
+        }
+
+        std::string arg;
+        while (in >> arg) {
+            Geometry geometry;
+            if (arg == "border") {
+                opts.border = true;
+            } else if (arg == "resizable") {
+                opts.resizable = true;
+            } else if (arg == "transparent") {
+                opts.transparent = true;
+            } else if (parseGeometry(arg.c_str(), geometry)) {
+                opts.width = geometry.width;
+                opts.height = geometry.height;
+                opts.positioned = geometry.positioned;
+                opts.x = geometry.x;
+                opts.y = geometry.y;
+            } else {
+                return failure("bad argument " + arg);
+            }
+        }
+
+        try {
+            int id = loop.add(std::make_unique<Renderer>(opts, m_context));
+            return "ok " + std::to_string(id) + "\n";
+        } catch (const std::exception& e) {
+            return failure(e.what());
+        }
+    }
+
+    if (command == "list") {
+        std::ostringstream out;
+        for (const auto& [id, renderer] : loop.renderers()) {
+            Geometry geometry = renderer->geometry();
+            out << id << " " << geometry.width << "x" << geometry.height
+                << std::showpos << geometry.x << geometry.y << std::noshowpos
+                << " " << renderer->url() << "\n";
+        }
+        out << "ok\n";
+        return out.str();
+    }
+
+    if (command == "quit") {
+        loop.quit();
+        return "ok\n";
+    }
+
+    if (command != "close" && command != "reload" && command != "move" &&
+        command != "resize") {
+        return failure("unknown command " + command);
+    }
+
+    int id;
+    Renderer* renderer = nullptr;
+    if (!(in >> id) || !(renderer = loop.find(id))) {
+        return failure("no such overlay");
+    }
+
+    if (command == "close") {
+        loop.remove(id);
+    } else if (command == "reload") {
+        renderer->reload();
+    } else if (command == "move") {
+        int x, y;
+        if (!(in >> x >> y)) {
+            return failure("usage: move ID X Y");
+        }
+        renderer->move(x, y);
+    } else if (command == "resize") {
+        int width, height;
+        if (!(in >> width >> height) || width <= 0 || height <= 0) {
+            return failure("usage: resize ID WIDTH HEIGHT");
+        }
+        renderer->resize(width, height);
+    }
+    return "ok\n";
+}
+
+void
+Daemon::process(MainLoop& loop)
+{
+    std::vector<Request> requests;
+    {
+        std::unique_lock guard(m_lock);
+        requests.swap(m_requests);
+    }
+
+    for (const auto& request : requests) {
+        Connection& connection = *request.connection;
+        if (connection.dropped) {
+            continue;
+        }
+        std::string reply = m_execute(loop, request.line);
+        /* Never wait on a client, that would stall every overlay. A client
+         * gone by now just misses its reply; one that doesn't read its
+         * replies is dropped, and the reader thread closes it. */
+        ssize_t sent = send(connection.fd, reply.data(), reply.size(),
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == ssize_t(reply.size())) {
+            continue;
+        }
+        if (sent >= 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            std::cerr << "Dropping daemon client that reads no replies"
+                      << std::endl;
+        }
+        connection.dropped = true;
+        shutdown(connection.fd, SHUT_RDWR);
+    }
+}
+
+} // namespace nanamo
@@ -0,0 +1,100 @@
+/** daemon.hh -- Overlay daemon definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_DAEMON_HH_
+#define NNM_DAEMON_HH_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "daemonfmt.hh"
+#include "loop.hh"
+#include "pump.hh"
+#include "renderer.hh"
+
+namespace nanamo {
+
+/**
+ * Opens and controls overlays on request of local clients.
+ *
+ * Keeping one process around saves new overlays the CEF startup. Clients
+ * are read on a thread of their own, which queues their commands and wakes
+ * the main loop through the pump to run them with process(). See
+ * daemonfmt.hh for the protocol.
+ */
+class Daemon {
+  private:
+    /* Longest command line we accept */
+    static constexpr size_t MAX_LINE = 64 * 1024;
+
+    struct Connection {
+        int fd;
+        std::string input;
+        /* Shut down for not reading its replies, set by the main loop */
+        bool dropped = false;
+
+        explicit Connection(int fd);
+        ~Connection();
+    };
+
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        std::string line;
+    };
+
+    std::string m_path;
+    RendererOptions m_defaults;
+    RenderContext& m_context;
+    MessagePump& m_pump;
+
+    int m_listenFd = -1;
+    int m_stopFd = -1;
+    std::thread m_thread;
+
+    std::mutex m_lock;
+    std::vector<Request> m_requests;
+
+    void m_serve();
+    bool m_read(const std::shared_ptr<Connection>&);
+    std::string m_execute(MainLoop&, const std::string& line);
+
+  public:
+    /** Listen on path, creating overlays from defaults */
+    Daemon(const std::string& path, const RendererOptions& defaults,
+           RenderContext&, MessagePump&);
+    ~Daemon();
+
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+
+    /** Run queued commands against loop */
+    void process(MainLoop& loop);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_DAEMON_HH_ */
@@ -0,0 +1,65 @@
+/** daemonfmt.hh -- Daemon control protocol definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_DAEMONFMT_HH_
+#define NNM_DAEMONFMT_HH_
+
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+/*
+ * A daemon reads commands from clients of a SOCK_STREAM Unix socket, one
+ * per line, arguments separated by spaces:
+ *
+ *   open URL [WxH[+X+Y]] [border] [resizable] [transparent]
+ *   close ID
+ *   reload ID
+ *   move ID X Y
+ *   resize ID WIDTH HEIGHT
+ *   list
+ *   quit
+ *
+ * Each command is answered with any number of data lines, then a line of
+ * "ok" or "error" followed by details. open answers "ok ID", list sends an
+ * "ID WxH+X+Y URL" line per overlay. Clients must read their replies: one
+ * whose replies no longer fit in the socket buffer is disconnected.
+ */
+
+namespace nanamo {
+
+/** Socket a daemon listens on when not told otherwise */
+inline std::string
+defaultDaemonSocket()
+{
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR")) {
+        return std::string(runtime) + "/nanamo.sock";
+    }
+    return "/tmp/nanamo-" + std::to_string(getuid()) + ".sock";
+}
+
+} // namespace nanamo
+
+#endif /* NNM_DAEMONFMT_HH_ */
@@ -0,0 +1,259 @@
+/** damage.cc -- Damage shrinking implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define NNM_X86 1
+#    include <immintrin.h>
+#endif
+
+#include "damage.hh"
+
+namespace nanamo {
+
+static bool
+equalScalar(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    uint64_t diff = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, 8);
+        std::memcpy(&y, b + i, 8);
+        diff |= x ^ y;
+    }
+    for (; i < size; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+#ifdef NNM_X86
+
+/* Differences are OR-ed together and tested once per row, rows are short
+ * enough that exiting at the first one would not pay for its branches */
+
+__attribute__((target("sse4.1"))) static bool
+equalSse41(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    __m128i diff = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(x, y));
+    }
+    return _mm_testz_si128(diff, diff) && equalScalar(a + i, b + i, size - i);
+}
+
+__attribute__((target("avx2"))) static bool
+equalAvx2(const uint8_t* a, const uint8_t* b, size_t size)
+{
+    __m256i diff = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(x, y));
+    }
+    return _mm256_testz_si256(diff, diff) &&
+           equalScalar(a + i, b + i, size - i);
+}
+
+#endif
+
+DamageShrinker::Kernel
+DamageShrinker::bestKernel()
+{
+    if (supported(Kernel::AVX2)) {
+        return Kernel::AVX2;
+    }
+    if (supported(Kernel::SSE41)) {
+        return Kernel::SSE41;
+    }
+    return Kernel::SCALAR;
+}
+
+bool
+DamageShrinker::supported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::SCALAR:
+        return true;
+#ifdef NNM_X86
+    case Kernel::SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case Kernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char*
+DamageShrinker::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::SCALAR:
+        return "scalar";
+    case Kernel::SSE41:
+        return "sse4.1";
+    case Kernel::AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+DamageShrinker::DamageShrinker(Kernel kernel) : m_kernel(kernel)
+{
+    if (!supported(kernel)) {
+        throw std::runtime_error(std::string("CPU lacks ") +
+                                 kernelName(kernel));
+    }
+    switch (kernel) {
+#ifdef NNM_X86
+    case Kernel::SSE41:
+        m_equal = equalSse41;
+        break;
+    case Kernel::AVX2:
+        m_equal = equalAvx2;
+        break;
+#endif
+    default:
+        m_equal = equalScalar;
+        break;
+    }
+}
+
+DamageShrinker::Kernel
+DamageShrinker::kernel() const
+{
+    return m_kernel;
+}
+
+bool
+DamageShrinker::m_tileChanged(const uint8_t* data, int x0, int y0, int x1,
+                              int y1)
+{
+    size_t stride = size_t(m_width) * 4;
+    size_t offset = y0 * stride + size_t(x0) * 4;
+    size_t size = size_t(x1 - x0) * 4;
+    for (int y = y0; y < y1; y++, offset += stride) {
+        if (m_equal(data + offset, m_shadow.data() + offset, size)) {
+            continue;
+        }
+        /* Rows above were equal, bring the rest up to date */
+        for (; y < y1; y++, offset += stride) {
+            std::memcpy(m_shadow.data() + offset, data + offset, size);
+        }
+        return true;
+    }
+    return false;
+}
+
+void
+DamageShrinker::m_addRun(RectList& out, size_t first, int x0, int y0, int x1,
+                         int y1)
+{
+    /* Extend a rect ending right above if it spans the same columns */
+    for (size_t i = first; i < out.size(); i++) {
+        CefRect& rect = out[i];
+        if (rect.x == x0 && rect.width == x1 - x0 &&
+            rect.y + rect.height == y0) {
+            rect.height = y1 - rect.y;
+            return;
+        }
+    }
+    out.emplace_back(x0, y0, x1 - x0, y1 - y0);
+}
+
+void
+DamageShrinker::shrink(const RectList& dirty, const void* data, int width,
+                       int height, RectList& out)
+{
+    auto pixels = static_cast<const uint8_t*>(data);
+    out.clear();
+    if (width != m_width || height != m_height) {
+        /* Nothing to compare with */
+        m_width = width;
+        m_height = height;
+        m_shadow.assign(pixels, pixels + size_t(width) * height * 4);
+        out = dirty;
+        return;
+    }
+
+    for (const auto& dirtyRect : dirty) {
+        int rx0 = std::max(dirtyRect.x, 0);
+        int ry0 = std::max(dirtyRect.y, 0);
+        int rx1 = std::min(dirtyRect.x + dirtyRect.width, width);
+        int ry1 = std::min(dirtyRect.y + dirtyRect.height, height);
+        if (rx0 >= rx1 || ry0 >= ry1) {
+            continue;
+        }
+
+        /* Runs of changed tiles per band of tile rows, merged with runs
+         * ending at the band's top; rects of other dirty rects stay apart */
+        size_t first = out.size();
+        for (int ty = ry0 / TILE_HEIGHT * TILE_HEIGHT; ty < ry1;
+             ty += TILE_HEIGHT) {
+            int y0 = std::max(ty, ry0);
+            int y1 = std::min(ty + TILE_HEIGHT, ry1);
+            int run = -1;
+            for (int tx = rx0 / TILE_WIDTH * TILE_WIDTH; tx < rx1;
+                 tx += TILE_WIDTH) {
+                int x0 = std::max(tx, rx0);
+                int x1 = std::min(tx + TILE_WIDTH, rx1);
+                bool changed = m_tileChanged(pixels, x0, y0, x1, y1);
+                if (changed && run < 0) {
+                    run = x0;
+                } else if (!changed && run >= 0) {
+                    m_addRun(out, first, run, y0, x0, y1);
+                    run = -1;
+                }
+            }
+            if (run >= 0) {
+                m_addRun(out, first, run, y0, rx1, y1);
+            }
+        }
+    }
+
+    if (out.size() > MAX_RECTS) {
+        int x0 = width, y0 = height, x1 = 0, y1 = 0;
+        for (const auto& rect : out) {
+            x0 = std::min(x0, rect.x);
+            y0 = std::min(y0, rect.y);
+            x1 = std::max(x1, rect.x + rect.width);
+            y1 = std::max(y1, rect.y + rect.height);
+        }
+        out.assign(1, CefRect(x0, y0, x1 - x0, y1 - y0));
+    }
+}
+
+} // namespace nanamo
@@ -0,0 +1,95 @@
+/** damage.hh -- Damage shrinking definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_DAMAGE_HH_
+#define NNM_DAMAGE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+namespace nanamo {
+
+/**
+ * Shrinks paint damage to the pixels that actually changed.
+ *
+ * CEF often reports the whole view dirty when little or nothing changed,
+ * after a layout invalidation or at the end of a transition. A shadow copy
+ * of the last frame is compared with each dirty rect tile by tile, and only
+ * the tiles that differ are kept; a paint that changed nothing yields no
+ * rects at all. Rows are compared with AVX2 or SSE4.1 where the CPU has
+ * them.
+ */
+class DamageShrinker {
+  public:
+    typedef CefRenderHandler::RectList RectList;
+
+    enum class Kernel {
+        SCALAR,
+        SSE41,
+        AVX2,
+    };
+
+  private:
+    /* A tile row is 256 bytes, 8 AVX2 compares */
+    static constexpr int TILE_WIDTH = 64;
+    static constexpr int TILE_HEIGHT = 16;
+    /* Beyond this many rects, keep their bounding box */
+    static constexpr size_t MAX_RECTS = 32;
+
+    Kernel m_kernel;
+    bool (*m_equal)(const uint8_t*, const uint8_t*, size_t);
+
+    std::vector<uint8_t> m_shadow;
+    int m_width = 0;
+    int m_height = 0;
+
+    bool m_tileChanged(const uint8_t* data, int x0, int y0, int x1, int y1);
+    void m_addRun(RectList& out, size_t first, int x0, int y0, int x1,
+                  int y1);
+
+  public:
+    /** The fastest kernel this CPU supports */
+    static Kernel bestKernel();
+    static bool supported(Kernel);
+    static const char* kernelName(Kernel);
+
+    explicit DamageShrinker(Kernel kernel = bestKernel());
+
+    Kernel kernel() const;
+
+    /**
+     * Set out to the parts of dirty that differ from the last frame, and
+     * keep data as the new last frame. On the first frame and after size
+     * changes all of dirty is kept.
+     */
+    void shrink(const RectList& dirty, const void* data, int width,
+                int height, RectList& out);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_DAMAGE_HH_ */
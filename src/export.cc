@@ -0,0 +1,283 @@
+/** export.cc -- Shared memory frame export implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "export.hh"
+#include "socket.hh"
+
+namespace nanamo {
+
+/* Pixel data starts page aligned after the header */
+static constexpr size_t DATA_ALIGN = 4096;
+
+FrameExporter::FrameExporter(const std::string& path) : m_path(path)
+{
+    m_listenFd = listenUnix(path, SOCK_SEQPACKET);
+
+    m_acceptThread = std::thread(&FrameExporter::m_acceptLoop, this);
+}
+
+FrameExporter::~FrameExporter()
+{
+    /* Makes the blocked accept() fail */
+    shutdown(m_listenFd, SHUT_RDWR);
+    m_acceptThread.join();
+    close(m_listenFd);
+    unlink(m_path.c_str());
+
+    for (int fd : m_clients) {
+        close(fd);
+    }
+    m_releaseBuffer();
+}
+
+void
+FrameExporter::m_acceptLoop()
+{
+    for (;;) {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+
+        std::unique_lock guard(m_lock);
+        if (m_bufferFd >= 0) {
+            ExportMessage msg = {EXPORT_BUFFER, 0, m_header->latest};
+            if (!m_send(fd, msg, m_bufferFd)) {
+                close(fd);
+                continue;
+            }
+        }
+        m_clients.push_back(fd);
+    }
+}
+
+bool
+FrameExporter::m_send(int fd, const ExportMessage& msg, int passFd)
+{
+    iovec iov = {const_cast<ExportMessage*>(&msg), sizeof(msg)};
+    msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    if (passFd >= 0) {
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+    }
+
+    if (sendmsg(fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+        return true;
+    }
+    /* A client too slow to keep up can skip frame notices, as the header
+     * always names the latest frame, but it must not miss a buffer */
+    return errno == EAGAIN && passFd < 0;
+}
+
+void
+FrameExporter::m_broadcast(const ExportMessage& msg, int passFd)
+{
+    std::unique_lock guard(m_lock);
+    std::erase_if(m_clients, [&](int fd) {
+        if (m_send(fd, msg, passFd)) {
+            return false;
+        }
+        close(fd);
+        return true;
+    });
+}
+
+void
+FrameExporter::m_allocBuffer(size_t slotSize)
+{
+    size_t dataOffset =
+        (sizeof(ExportHeader) + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1);
+    size_t size = dataOffset + slotSize * EXPORT_SLOTS;
+
+    int fd = memfd_create("nanamo-frames", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        throw systemError("memfd_create");
+    }
+    if (ftruncate(fd, size) < 0) {
+        auto error = systemError("ftruncate");
+        close(fd);
+        throw error;
+    }
+    /* Keep clients from resizing the buffer under us */
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    void* mapped =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        auto error = systemError("mmap");
+        close(fd);
+        throw error;
+    }
+
+    auto header = new (mapped) ExportHeader();
+    header->magic = EXPORT_MAGIC;
+    header->version = EXPORT_VERSION;
+    header->slotCount = EXPORT_SLOTS;
+    header->slotSize = slotSize;
+    header->dataOffset = dataOffset;
+    header->latest = m_frame;
+
+    {
+        std::unique_lock guard(m_lock);
+        m_releaseBuffer();
+        m_header = header;
+        m_mappedSize = size;
+        m_bufferFd = fd;
+    }
+    m_broadcast({EXPORT_BUFFER, 0, m_frame}, fd);
+}
+
+void
+FrameExporter::m_releaseBuffer()
+{
+    if (m_header) {
+        munmap(m_header, m_mappedSize);
+        m_header = nullptr;
+    }
+    if (m_bufferFd >= 0) {
+        close(m_bufferFd);
+        m_bufferFd = -1;
+    }
+}
+
+static void
+copyRect(uint8_t* dst, const uint8_t* src, int width, int height,
+         const ExportRect& rect)
+{
+    int x0 = std::max(rect.x, 0);
+    int y0 = std::max(rect.y, 0);
+    int x1 = std::min(rect.x + rect.width, width);
+    int y1 = std::min(rect.y + rect.height, height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    size_t stride = size_t(width) * 4;
+    size_t offset = y0 * stride + size_t(x0) * 4;
+    size_t len = size_t(x1 - x0) * 4;
+    for (int y = y0; y < y1; y++, offset += stride) {
+        std::memcpy(dst + offset, src + offset, len);
+    }
+}
+
+void
+FrameExporter::publish(const CefRenderHandler::RectList& dirtyRects,
+                       const void* data, int width, int height)
+{
+    if (m_failed) {
+        return;
+    }
+    size_t frameSize = size_t(width) * height * 4;
+    if (!m_header || frameSize > m_header->slotSize) {
+        try {
+            m_allocBuffer(frameSize);
+        } catch (const std::exception& e) {
+            /* Can't throw through CEF, and the old buffer is too small */
+            std::cerr << "Exporting stopped: " << e.what() << std::endl;
+            m_failed = true;
+            std::unique_lock guard(m_lock);
+            m_releaseBuffer();
+            return;
+        }
+    }
+
+    uint64_t frame = ++m_frame;
+    int index = frame % EXPORT_SLOTS;
+    ExportSlot& slot = m_header->slots[index];
+
+    /* The slot still holds the frame from EXPORT_SLOTS ago, which was
+     * overwritten by this frame's damage and that of the frames between */
+    std::vector<ExportRect>& damage = m_damage[index];
+    damage.clear();
+    if (width != m_lastWidth || height != m_lastHeight) {
+        damage.push_back({0, 0, width, height});
+        m_lastWidth = width;
+        m_lastHeight = height;
+    } else {
+        for (const auto& rect : dirtyRects) {
+            damage.push_back({rect.x, rect.y, rect.width, rect.height});
+        }
+    }
+    bool full = slot.width != uint32_t(width) ||
+                slot.height != uint32_t(height) ||
+                slot.frame + EXPORT_SLOTS != frame;
+
+    uint32_t lock = slot.lock.load(std::memory_order_relaxed);
+    slot.lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto src = static_cast<const uint8_t*>(data);
+    auto dst = reinterpret_cast<uint8_t*>(m_header) + m_header->dataOffset +
+               index * m_header->slotSize;
+    if (full) {
+        std::memcpy(dst, src, frameSize);
+    } else {
+        for (const auto& rects : m_damage) {
+            for (const auto& rect : rects) {
+                copyRect(dst, src, width, height, rect);
+            }
+        }
+    }
+
+    slot.width = width;
+    slot.height = height;
+    if (damage.size() > EXPORT_MAX_RECTS) {
+        slot.rectCount = 1;
+        slot.rects[0] = {0, 0, width, height};
+    } else {
+        slot.rectCount = damage.size();
+        std::copy(damage.begin(), damage.end(), slot.rects);
+    }
+    slot.frame = frame;
+    slot.lock.store(lock + 2, std::memory_order_release);
+
+    m_header->latest.store(frame, std::memory_order_release);
+    m_broadcast({EXPORT_FRAME, uint32_t(index), frame}, -1);
+}
+
+} // namespace nanamo
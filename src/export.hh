@@ -0,0 +1,89 @@
+/** export.hh -- Shared memory frame export definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_EXPORT_HH_
+#define NNM_EXPORT_HH_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+#include "exportfmt.hh"
+
+namespace nanamo {
+
+/**
+ * Publishes painted frames to other processes through shared memory.
+ *
+ * See exportfmt.hh for the layout and protocol. Clients are accepted on a
+ * thread of their own, so connecting works however rarely the page paints.
+ */
+class FrameExporter {
+  private:
+    std::string m_path;
+    int m_listenFd = -1;
+    std::thread m_acceptThread;
+
+    /* Guards the client list and the buffer fd, both of which the accept
+     * thread needs */
+    std::mutex m_lock;
+    std::vector<int> m_clients;
+    int m_bufferFd = -1;
+
+    ExportHeader* m_header = nullptr;
+    size_t m_mappedSize = 0;
+    /* Set once a buffer couldn't be allocated, exporting stops for good */
+    bool m_failed = false;
+
+    uint64_t m_frame = 0;
+    int m_lastWidth = 0;
+    int m_lastHeight = 0;
+    /* Damage of the last EXPORT_SLOTS frames, indexed like the slots */
+    std::vector<ExportRect> m_damage[EXPORT_SLOTS];
+
+    void m_acceptLoop();
+    void m_allocBuffer(size_t slotSize);
+    void m_releaseBuffer();
+    bool m_send(int fd, const ExportMessage&, int passFd);
+    void m_broadcast(const ExportMessage&, int passFd);
+
+  public:
+    /** Listen for clients on the Unix socket at path */
+    explicit FrameExporter(const std::string& path);
+    ~FrameExporter();
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    void publish(const CefRenderHandler::RectList& dirtyRects,
+                 const void* data, int width, int height);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_EXPORT_HH_ */
@@ -0,0 +1,102 @@
+/** exportfmt.hh -- Frame export wire format definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_EXPORTFMT_HH_
+#define NNM_EXPORTFMT_HH_
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Frames are exported through a memfd holding an ExportHeader followed by
+ * EXPORT_SLOTS pixel slots, written round robin: frame n lives in slot
+ * n % EXPORT_SLOTS. Pixels are premultiplied BGRA, rows are width * 4 bytes
+ * apart, and slot i starts at dataOffset + i * slotSize.
+ *
+ * Consumers connect to a SOCK_SEQPACKET Unix socket and receive
+ * ExportMessages. EXPORT_BUFFER carries a new memfd as SCM_RIGHTS; it is
+ * sent on connect and whenever the producer has to grow the buffer, after
+ * which the old one is no longer written. EXPORT_FRAME announces a newly
+ * completed frame.
+ *
+ * Each slot is guarded by a sequence lock: lock is odd while the producer
+ * writes the slot. A consumer reads lock, copies, then reads lock again and
+ * discards the copy if either value was odd or they differ. The rects of a
+ * slot are the areas that changed since the previous frame, so a consumer
+ * holding frame n - 1 only needs to copy those to get frame n.
+ */
+
+namespace nanamo {
+
+static constexpr uint32_t EXPORT_MAGIC = 0x4f4d4e4e; /* "NNMO" */
+static constexpr uint32_t EXPORT_VERSION = 1;
+static constexpr int EXPORT_SLOTS = 3;
+static constexpr int EXPORT_MAX_RECTS = 64;
+
+struct ExportRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct ExportSlot {
+    std::atomic<uint32_t> lock;
+    uint32_t width;
+    uint32_t height;
+    uint32_t rectCount;
+    uint64_t frame;
+    ExportRect rects[EXPORT_MAX_RECTS];
+};
+
+struct ExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t reserved;
+    uint64_t slotSize;
+    uint64_t dataOffset;
+    /* Newest completed frame, 0 before the first one */
+    std::atomic<uint64_t> latest;
+    ExportSlot slots[EXPORT_SLOTS];
+};
+
+enum ExportMessageType : uint32_t {
+    EXPORT_BUFFER = 1,
+    EXPORT_FRAME = 2,
+};
+
+struct ExportMessage {
+    uint32_t type;
+    uint32_t slot;
+    uint64_t frame;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory atomics must be lock free");
+
+} // namespace nanamo
+
+#endif /* NNM_EXPORTFMT_HH_ */
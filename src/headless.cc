@@ -0,0 +1,232 @@
+/** headless.cc -- Windowless overlay implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+
+#include <cef_app.h>
+
+#include "headless.hh"
+#include "stats.hh"
+#include "trace.hh"
+
+namespace nanamo {
+
+HeadlessOverlay::HeadlessOverlay(const RendererOptions& opts)
+    : m_governor(opts.frameRate)
+{
+    m_renderHandler =
+        new BrowserRenderHandler(opts.width, opts.height, opts.renderScale);
+    m_renderHandler->disableUpload();
+    m_spawnBrowser(opts);
+}
+
+HeadlessOverlay::HeadlessOverlay(const RendererOptions& opts,
+                                 RenderContext& context, MessagePump& pump)
+    : m_governor(opts.frameRate), m_context(&context)
+{
+    m_renderHandler =
+        new BrowserRenderHandler(opts.width, opts.height, opts.renderScale);
+    if (opts.threaded) {
+        m_renderHandler->enableMailbox([&pump] { pump.wake(); });
+    }
+    m_surface.emplace(context, opts.width, opts.height);
+    m_compositor.emplace(context, *m_surface, m_renderHandler,
+                         opts.sharpness);
+    m_spawnBrowser(opts);
+}
+
+void
+HeadlessOverlay::m_spawnBrowser(const RendererOptions& opts)
+{
+    StartupReport* startup = StartupReport::get();
+    m_startup = startup ? startup->addOverlay(opts.url) : nullptr;
+
+    /* Nobody is looking at a particular monitor, treat it as focused */
+    m_governor.onFocus(true);
+
+    CefBrowserSettings browserSettings;
+    browserSettings.windowless_frame_rate = m_governor.initialFps();
+
+    CefWindowInfo windowInfo;
+    windowInfo.SetAsWindowless(0);
+
+    if (opts.shrinkDamage) {
+        m_renderHandler->enableDamageShrinking();
+    }
+    if (!opts.exportPath.empty()) {
+        m_renderHandler->enableExport(opts.exportPath);
+    }
+    if (!opts.recordPath.empty()) {
+        m_renderHandler->enableRecording(opts.recordPath);
+    }
+    if (m_startup) {
+        StartupReport::Overlay* startup = m_startup;
+        m_renderHandler->onFirstPaint(
+            [startup] { startup->mark(StartupReport::FIRST_PAINT); });
+    }
+    /* The loop never sleeps long enough to need waking for the browser */
+    m_browserClient = new BrowserClient(m_renderHandler);
+    if (!m_browserClient->create(windowInfo, opts.url, browserSettings)) {
+        throw std::runtime_error("Failed to create browser");
+    }
+}
+
+HeadlessOverlay::~HeadlessOverlay()
+{
+    m_browserClient->close();
+    if (m_context) {
+        m_context->makeCurrent();
+    }
+    m_renderHandler->close();
+}
+
+void
+HeadlessOverlay::takeFrame()
+{
+    m_renderHandler->takeFrame();
+}
+
+void
+HeadlessOverlay::frame()
+{
+    if (!m_browser && (m_browser = m_browserClient->takeBrowser())) {
+        m_governor.setBrowser(m_browser);
+        if (m_startup) {
+            m_startup->mark(StartupReport::BROWSER);
+        }
+    }
+
+    bool painted = m_renderHandler->takePainted();
+    if (painted) {
+        m_governor.onPaint();
+    }
+    m_governor.update();
+    if (m_compositor) {
+        m_compositor->frame(painted);
+    }
+    if (m_startup && painted) {
+        m_startup->mark(StartupReport::FIRST_FRAME);
+        StartupReport::get()->update();
+        m_startup = nullptr;
+    }
+}
+
+HeadlessLoop::HeadlessLoop(MessagePump& pump, RenderContext* context)
+    : m_pump(pump), m_context(context)
+{
+}
+
+void
+HeadlessLoop::add(std::unique_ptr<HeadlessOverlay> overlay)
+{
+    m_overlays.push_back(std::move(overlay));
+    /* As in MainLoop::add */
+    if (m_pump.due()) {
+        if (m_context) {
+            m_context->makeCurrent();
+        }
+        m_pump.doWork();
+    }
+}
+
+void
+HeadlessLoop::quitAfter(double seconds)
+{
+    m_deadline = Stats::now() + int64_t(seconds * 1e9);
+}
+
+static std::atomic<bool> interrupted = false;
+
+static void
+interruptHandler(int)
+{
+    interrupted = true;
+}
+
+void
+HeadlessLoop::run()
+{
+    /* The pump never sleeps longer than its maximum delay, so the flag is
+     * seen soon enough without having to wake the wait */
+    std::signal(SIGINT, interruptHandler);
+    std::signal(SIGTERM, interruptHandler);
+
+    while (!interrupted && Stats::now() < m_deadline) {
+        m_pump.wait(m_pump.timeout());
+
+        TraceSpan span("mainLoop");
+        Stats* stats = Stats::get();
+        int64_t start = stats ? Stats::now() : 0;
+
+        /* As in MainLoop, paints are uploaded in CEF work or taken from
+         * the overlays' mailboxes */
+        if (m_context) {
+            m_context->makeCurrent();
+        }
+        if (m_pump.due()) {
+            m_pump.doWork();
+        }
+        if (m_context) {
+            for (auto& overlay : m_overlays) {
+                overlay->takeFrame();
+            }
+        }
+        for (auto& overlay : m_overlays) {
+            overlay->frame();
+        }
+
+        if (stats) {
+            stats->loopIteration.record(Stats::now() - start);
+            stats->tick();
+        }
+    }
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+}
+
+void
+HeadlessLoop::close()
+{
+    m_overlays.clear();
+
+    int64_t deadline = Stats::now() + CLOSE_TIMEOUT;
+    while (BrowserClient::openBrowsers() > 0 && Stats::now() < deadline) {
+        m_pump.wait(m_pump.timeout());
+        if (m_pump.due()) {
+            if (m_context) {
+                m_context->makeCurrent();
+            }
+            m_pump.doWork();
+        }
+    }
+    if (BrowserClient::openBrowsers() > 0) {
+        std::cerr << "Browsers still open at shutdown" << std::endl;
+    }
+}
+
+} // namespace nanamo
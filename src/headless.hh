@@ -0,0 +1,112 @@
+/** headless.hh -- Windowless overlay definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_HEADLESS_HH_
+#define NNM_HEADLESS_HH_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "browser.hh"
+#include "compositor.hh"
+#include "pump.hh"
+#include "renderer.hh"
+#include "startup.hh"
+#include "surface.hh"
+#include "throttle.hh"
+
+namespace nanamo {
+
+/**
+ * An overlay without a window, whose frames go to its exporter or recorder.
+ *
+ * Without a render context no GL is involved, so this runs where there is
+ * no display at all. Given a (surfaceless) one, paints are also uploaded
+ * and drawn into an offscreen surface just as a window would show them.
+ */
+class HeadlessOverlay {
+  private:
+    FrameRateGovernor m_governor;
+    RenderContext* m_context = nullptr;
+    /* Null once startup was reported on */
+    StartupReport::Overlay* m_startup = nullptr;
+
+    CefRefPtr<BrowserRenderHandler> m_renderHandler;
+    CefRefPtr<BrowserClient> m_browserClient;
+    /* Null until created */
+    CefRefPtr<CefBrowser> m_browser;
+
+    std::optional<OffscreenSurface> m_surface;
+    std::optional<Compositor> m_compositor;
+
+    void m_spawnBrowser(const RendererOptions&);
+
+  public:
+    explicit HeadlessOverlay(const RendererOptions&);
+    /**
+     * Draw offscreen in context; with opts.threaded, pump is woken for
+     * frames painted on CEF's thread
+     */
+    HeadlessOverlay(const RendererOptions&, RenderContext&, MessagePump&);
+    ~HeadlessOverlay();
+
+    HeadlessOverlay(const HeadlessOverlay&) = delete;
+    HeadlessOverlay& operator=(const HeadlessOverlay&) = delete;
+
+    /** Upload a new frame painted on CEF's thread */
+    void takeFrame();
+    /** Track paints for frame rate throttling, and draw them if offscreen */
+    void frame();
+};
+
+/** Event loop for headless overlays, the counterpart of MainLoop */
+class HeadlessLoop {
+  private:
+    /* Longest close() waits for browsers to close, in nanoseconds */
+    static constexpr int64_t CLOSE_TIMEOUT = 5'000'000'000;
+
+    MessagePump& m_pump;
+    RenderContext* m_context;
+    std::vector<std::unique_ptr<HeadlessOverlay>> m_overlays;
+    int64_t m_deadline = INT64_MAX;
+
+  public:
+    /** Paints are uploaded with context current, if given */
+    explicit HeadlessLoop(MessagePump&, RenderContext* context = nullptr);
+
+    void add(std::unique_ptr<HeadlessOverlay>);
+    /** Make run() return after the given number of seconds */
+    void quitAfter(double seconds);
+
+    /** Run until SIGINT or SIGTERM, or the deadline */
+    void run();
+    /** Close every overlay and wait for their browsers, as MainLoop */
+    void close();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_HEADLESS_HH_ */
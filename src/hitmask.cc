@@ -0,0 +1,218 @@
+/** hitmask.cc -- Alpha hit-test mask implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <utility>
+
+#include "hitmask.hh"
+
+#ifdef NNM_WITH_XSHAPE
+#    define GLFW_EXPOSE_NATIVE_X11
+#    include <GLFW/glfw3native.h>
+#    include <X11/extensions/shape.h>
+#endif
+
+namespace nanamo {
+
+HitMask::HitMask(uint8_t threshold) : m_threshold(threshold) {}
+
+void
+HitMask::m_updateRow(const uint8_t* row, int y, int x0, int x1)
+{
+    uint64_t* words = m_bits.data() + size_t(y) * m_stride;
+    int x = x0;
+    while (x < x1) {
+        /* Gather the bits of one word, then merge it in under a mask */
+        int word = x / 64;
+        int end = std::min(x1, (word + 1) * 64);
+        uint64_t bits = 0;
+        uint64_t mask = 0;
+        for (; x < end; x++) {
+            uint64_t bit = uint64_t(1) << (x % 64);
+            mask |= bit;
+            if (row[x * 4 + 3] > m_threshold) {
+                bits |= bit;
+            }
+        }
+
+        uint64_t merged = (words[word] & ~mask) | bits;
+        if (merged != words[word]) {
+            words[word] = merged;
+            m_changed = true;
+        }
+    }
+}
+
+void
+HitMask::update(const RectList& dirtyRects, const void* data, int width,
+                int height)
+{
+    auto pixels = static_cast<const uint8_t*>(data);
+    size_t stride = size_t(width) * 4;
+
+    if (width != m_width || height != m_height) {
+        m_width = width;
+        m_height = height;
+        m_stride = (width + 63) / 64;
+        m_bits.assign(size_t(m_stride) * height, 0);
+        m_changed = true;
+        for (int y = 0; y < height; y++) {
+            m_updateRow(pixels + y * stride, y, 0, width);
+        }
+        return;
+    }
+
+    for (const auto& rect : dirtyRects) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.width, width);
+        int y1 = std::min(rect.y + rect.height, height);
+        for (int y = y0; y < y1; y++) {
+            m_updateRow(pixels + y * stride, y, x0, x1);
+        }
+    }
+}
+
+int
+HitMask::width() const
+{
+    return m_width;
+}
+
+int
+HitMask::height() const
+{
+    return m_height;
+}
+
+bool
+HitMask::hit(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return false;
+    }
+    uint64_t word = m_bits[size_t(y) * m_stride + x / 64];
+    return (word >> (x % 64)) & 1;
+}
+
+bool
+HitMask::takeChanged()
+{
+    return std::exchange(m_changed, false);
+}
+
+void
+HitMask::region(std::vector<CefRect>& rects) const
+{
+    rects.clear();
+
+    /* Rects still growing downwards, and the spans they were built from */
+    std::vector<size_t> open;
+    std::vector<std::pair<int, int>> spans, prevSpans;
+
+    for (int y = 0; y < m_height; y++) {
+        spans.clear();
+        const uint64_t* words = m_bits.data() + size_t(y) * m_stride;
+
+        /* Bits past the row width are never set, so runs end in time */
+        int runStart = -1;
+        for (int w = 0; w < m_stride; w++) {
+            uint64_t word = words[w];
+            if (word == (runStart < 0 ? 0 : ~uint64_t(0))) {
+                continue;
+            }
+            int bit = 0;
+            while (bit < 64) {
+                uint64_t rest = (runStart < 0 ? word : ~word) >> bit;
+                if (!rest) {
+                    break;
+                }
+                bit += std::countr_zero(rest);
+                if (runStart < 0) {
+                    runStart = w * 64 + bit;
+                } else {
+                    spans.emplace_back(runStart, w * 64 + bit);
+                    runStart = -1;
+                }
+            }
+        }
+        if (runStart >= 0) {
+            spans.emplace_back(runStart, m_width);
+        }
+
+        if (y > 0 && spans == prevSpans) {
+            for (size_t i : open) {
+                rects[i].height++;
+            }
+            continue;
+        }
+
+        open.clear();
+        for (const auto& [start, end] : spans) {
+            open.push_back(rects.size());
+            rects.emplace_back(start, y, end - start, 1);
+        }
+        std::swap(spans, prevSpans);
+    }
+}
+
+bool
+setInputRegion(GLFWwindow* window, const std::vector<CefRect>& rects,
+               double scaleX, double scaleY)
+{
+#ifdef NNM_WITH_XSHAPE
+    Display* display = glfwGetX11Display();
+    if (!display) {
+        return false;
+    }
+
+    /* Round outwards so scaled rects never leave gaps between them */
+    std::vector<XRectangle> xrects;
+    xrects.reserve(rects.size());
+    for (const auto& rect : rects) {
+        int x0 = std::floor(rect.x * scaleX);
+        int y0 = std::floor(rect.y * scaleY);
+        int x1 = std::ceil((rect.x + rect.width) * scaleX);
+        int y1 = std::ceil((rect.y + rect.height) * scaleY);
+        xrects.push_back({short(x0), short(y0), (unsigned short)(x1 - x0),
+                          (unsigned short)(y1 - y0)});
+    }
+
+    XShapeCombineRectangles(display, glfwGetX11Window(window), ShapeInput, 0,
+                            0, xrects.data(), xrects.size(), ShapeSet,
+                            Unsorted);
+    XFlush(display);
+    return true;
+#else
+    (void)window;
+    (void)rects;
+    (void)scaleX;
+    (void)scaleY;
+    return false;
+#endif
+}
+
+} // namespace nanamo
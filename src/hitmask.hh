@@ -0,0 +1,89 @@
+/** hitmask.hh -- Alpha hit-test mask definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_HITMASK_HH_
+#define NNM_HITMASK_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+#include <GLFW/glfw3.h>
+
+namespace nanamo {
+
+/**
+ * One bit per pixel telling whether the page is opaque enough to take input.
+ *
+ * Kept up to date from the dirty rects of each paint, so a paint costs one
+ * pass over the pixels that changed. The input region derived from it is
+ * only rebuilt when some bit actually flipped.
+ */
+class HitMask {
+  public:
+    typedef CefRenderHandler::RectList RectList;
+
+  private:
+    uint8_t m_threshold;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0; /* words per row */
+    std::vector<uint64_t> m_bits;
+    bool m_changed = false;
+
+    void m_updateRow(const uint8_t* row, int y, int x0, int x1);
+
+  public:
+    /** Pixels with alpha above threshold take input */
+    explicit HitMask(uint8_t threshold);
+
+    void update(const RectList& dirtyRects, const void* data, int width,
+                int height);
+
+    int width() const;
+    int height() const;
+    bool hit(int x, int y) const;
+
+    /** Whether the mask changed since the last call */
+    bool takeChanged();
+
+    /**
+     * Cover the opaque pixels with rectangles, vertically merging runs of
+     * rows that have identical spans
+     */
+    void region(std::vector<CefRect>& rects) const;
+};
+
+/**
+ * Restrict the window's input region to rects, given in a buffer of
+ * scaleX/scaleY window pixels per buffer pixel. Returns false where the
+ * platform doesn't support input regions.
+ */
+bool setInputRegion(GLFWwindow*, const std::vector<CefRect>& rects,
+                    double scaleX, double scaleY);
+
+} // namespace nanamo
+
+#endif /* NNM_HITMASK_HH_ */
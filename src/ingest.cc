@@ -0,0 +1,347 @@
+/** ingest.cc -- Data ingest implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cef_process_message.h>
+#include <cef_shared_process_message_builder.h>
+#include <cef_v8.h>
+
+#include "ingest.hh"
+#include "socket.hh"
+#include "stats.hh"
+
+namespace nanamo {
+
+IngestServer::IngestServer(const std::string& path,
+                           std::function<void()> notify)
+    : m_path(path), m_notify(std::move(notify))
+{
+    m_listenFd = listenUnix(path, SOCK_SEQPACKET);
+
+    m_eventFd = eventfd(0, EFD_CLOEXEC);
+    if (m_eventFd < 0) {
+        auto error = systemError("eventfd");
+        close(m_listenFd);
+        throw error;
+    }
+
+    m_thread = std::thread(&IngestServer::m_serve, this);
+}
+
+IngestServer::~IngestServer()
+{
+    m_stopping = true;
+    m_signal();
+    m_thread.join();
+
+    close(m_eventFd);
+    close(m_listenFd);
+    unlink(m_path.c_str());
+}
+
+void
+IngestServer::m_signal()
+{
+    uint64_t one = 1;
+    if (write(m_eventFd, &one, sizeof(one)) != sizeof(one)) {
+        std::cerr << "Failed to wake ingest thread" << std::endl;
+        std::abort();
+    }
+}
+
+bool
+IngestServer::m_read(int fd)
+{
+    /* MSG_TRUNC has recv() return the full length of larger messages */
+    ssize_t len = recv(fd, m_buffer.data(), m_buffer.size(),
+                       MSG_DONTWAIT | MSG_TRUNC);
+    if (len < 0) {
+        return errno == EINTR || errno == EAGAIN;
+    }
+    if (len == 0 || size_t(len) > m_buffer.size()) {
+        /* Closed, or too large to take */
+        return false;
+    }
+
+    IngestRecord record = {uint32_t(len), 0};
+    bool first;
+    {
+        std::unique_lock guard(m_lock);
+        first = m_batch.empty();
+
+        size_t offset = m_batch.size();
+        m_batch.resize(offset + ingestRecordSize(len));
+        uint8_t* dst = m_batch.data() + offset;
+        std::memcpy(dst, &record, sizeof(record));
+        std::memcpy(dst + sizeof(record), m_buffer.data(), len);
+
+        m_count++;
+        m_full = m_batch.size() >= MAX_BATCH;
+    }
+    if (first) {
+        m_notify();
+    }
+    return true;
+}
+
+void
+IngestServer::m_serve()
+{
+    std::vector<int> connections;
+    std::vector<pollfd> fds;
+    m_buffer.resize(INGEST_MAX_MESSAGE);
+
+    while (!m_stopping) {
+        bool full;
+        {
+            std::unique_lock guard(m_lock);
+            full = m_full;
+        }
+
+        /* Leave producers blocked while the batch is full, flush() wakes
+         * us once it is taken */
+        fds.clear();
+        fds.push_back({m_eventFd, POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (int fd : connections) {
+            fds.push_back({fd, short(full ? 0 : POLLIN), 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Ingest stopped: " << std::strerror(errno)
+                      << std::endl;
+            break;
+        }
+        if (fds[0].revents) {
+            uint64_t value;
+            if (read(m_eventFd, &value, sizeof(value)) < 0) {
+                /* Nothing to do, the counter is reset either way */
+            }
+            continue;
+        }
+
+        for (size_t i = connections.size(); i-- > 0;) {
+            if (fds[i + 2].revents && !m_read(connections[i])) {
+                close(connections[i]);
+                connections.erase(connections.begin() + i);
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                connections.push_back(fd);
+            }
+        }
+    }
+
+    for (int fd : connections) {
+        close(fd);
+    }
+}
+
+void
+IngestServer::setInterval(int64_t ns)
+{
+    m_interval = ns;
+}
+
+double
+IngestServer::timeout() const
+{
+    std::unique_lock guard(m_lock);
+    if (m_batch.empty()) {
+        return -1;
+    }
+    int64_t due = m_lastFlush + m_interval - Stats::now();
+    return due > 0 ? due / 1e9 : 0;
+}
+
+static CefRefPtr<CefProcessMessage>
+batchMessage(const std::vector<uint8_t>& batch)
+{
+    auto builder =
+        CefSharedProcessMessageBuilder::Create(INGEST_MESSAGE, batch.size());
+    if (builder && builder->IsValid()) {
+        std::memcpy(builder->Memory(), batch.data(), batch.size());
+        return builder->Build();
+    }
+
+    /* Without shared memory, the batch is copied over IPC */
+    auto message = CefProcessMessage::Create(INGEST_MESSAGE);
+    message->GetArgumentList()->SetBinary(
+        0, CefBinaryValue::Create(batch.data(), batch.size()));
+    return message;
+}
+
+void
+IngestServer::flush(CefRefPtr<CefBrowser> browser)
+{
+    int64_t now = Stats::now();
+    if (now - m_lastFlush < m_interval) {
+        return;
+    }
+
+    int count;
+    bool full;
+    {
+        std::unique_lock guard(m_lock);
+        if (m_batch.empty()) {
+            return;
+        }
+        /* Swapped rather than moved, both keep their capacity */
+        m_sending.swap(m_batch);
+        m_batch.clear();
+        count = m_count;
+        m_count = 0;
+        full = m_full;
+        m_full = false;
+    }
+    if (full) {
+        m_signal();
+    }
+    m_lastFlush = now;
+
+    browser->GetMainFrame()->SendProcessMessage(PID_RENDERER,
+                                                batchMessage(m_sending));
+
+    if (Stats* stats = Stats::get()) {
+        stats->ingestMessages += count;
+        stats->ingestBytes += m_sending.size();
+    }
+}
+
+void
+IngestReceiver::OnContextCreated(CefRefPtr<CefBrowser>,
+                                 CefRefPtr<CefFrame> frame,
+                                 CefRefPtr<CefV8Context> context)
+{
+    if (!frame->IsMain()) {
+        return;
+    }
+    context->GetGlobal()->SetValue("nanamo",
+                                   CefV8Value::CreateObject(nullptr, nullptr),
+                                   V8_PROPERTY_ATTRIBUTE_READONLY);
+}
+
+class BufferRelease : public CefV8ArrayBufferReleaseCallback {
+  public:
+    void ReleaseBuffer(void* buffer) override final
+    {
+        std::free(buffer);
+    }
+
+    IMPLEMENT_REFCOUNTING(BufferRelease);
+};
+
+/* Make an array of ArrayBuffers from the messages in a batch */
+static CefRefPtr<CefV8Value>
+unpackBatch(const uint8_t* data, size_t size)
+{
+    std::vector<CefRefPtr<CefV8Value>> buffers;
+    CefRefPtr<BufferRelease> release = new BufferRelease();
+
+    size_t offset = 0;
+    while (offset + sizeof(IngestRecord) <= size) {
+        IngestRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        /* Shared memory may be rounded up with zeroes past the end */
+        if (record.size == 0 ||
+            offset + ingestRecordSize(record.size) > size) {
+            break;
+        }
+
+        void* payload = std::malloc(record.size);
+        if (!payload) {
+            break;
+        }
+        std::memcpy(payload, data + offset + sizeof(record), record.size);
+        buffers.push_back(
+            CefV8Value::CreateArrayBuffer(payload, record.size, release));
+        offset += ingestRecordSize(record.size);
+    }
+
+    CefRefPtr<CefV8Value> array = CefV8Value::CreateArray(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+        array->SetValue(i, buffers[i]);
+    }
+    return array;
+}
+
+bool
+IngestReceiver::OnProcessMessageReceived(CefRefPtr<CefBrowser>,
+                                         CefRefPtr<CefFrame> frame,
+                                         CefProcessId,
+                                         CefRefPtr<CefProcessMessage> message)
+{
+    if (message->GetName().ToString() != INGEST_MESSAGE) {
+        return false;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    CefRefPtr<CefSharedMemoryRegion> region =
+        message->GetSharedMemoryRegion();
+    CefRefPtr<CefBinaryValue> binary;
+    if (region && region->IsValid()) {
+        data = static_cast<const uint8_t*>(region->Memory());
+        size = region->Size();
+    } else if ((binary = message->GetArgumentList()->GetBinary(0))) {
+        data = static_cast<const uint8_t*>(binary->GetRawData());
+        size = binary->GetSize();
+    } else {
+        return true;
+    }
+
+    CefRefPtr<CefV8Context> context = frame->GetV8Context();
+    if (!context || !context->Enter()) {
+        /* No page to deliver to */
+        return true;
+    }
+    CefRefPtr<CefV8Value> nanamo = context->GetGlobal()->GetValue("nanamo");
+    CefRefPtr<CefV8Value> ondata;
+    if (nanamo && nanamo->IsObject()) {
+        ondata = nanamo->GetValue("ondata");
+    }
+    if (ondata && ondata->IsFunction()) {
+        ondata->ExecuteFunction(nanamo, {unpackBatch(data, size)});
+    }
+    context->Exit();
+    return true;
+}
+
+} // namespace nanamo
@@ -0,0 +1,114 @@
+/** ingest.hh -- Data ingest definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_INGEST_HH_
+#define NNM_INGEST_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cef_browser.h>
+#include <cef_render_process_handler.h>
+
+#include "ingestfmt.hh"
+
+namespace nanamo {
+
+/**
+ * Takes messages from local producers for a page, see ingestfmt.hh.
+ *
+ * A thread of its own reads producers straight into the pending batch.
+ * The render loop sends the batch to the page at most once per interval,
+ * so a flood of small messages costs the page one call per frame.
+ */
+class IngestServer {
+  private:
+    /* Pending bytes past which producers are no longer read */
+    static constexpr size_t MAX_BATCH = 16 * 1024 * 1024;
+
+    std::string m_path;
+    std::function<void()> m_notify;
+
+    int m_listenFd = -1;
+    int m_eventFd = -1;
+    std::atomic<bool> m_stopping = false;
+    std::thread m_thread;
+
+    /* Receive buffer of the thread */
+    std::vector<uint8_t> m_buffer;
+
+    mutable std::mutex m_lock;
+    std::vector<uint8_t> m_batch;
+    int m_count = 0;
+    bool m_full = false;
+    /* Moved out of m_batch for sending, kept to reuse its memory */
+    std::vector<uint8_t> m_sending;
+
+    int64_t m_interval = 0;
+    int64_t m_lastFlush = 0;
+
+    void m_serve();
+    bool m_read(int fd);
+    void m_signal();
+
+  public:
+    /** Listen on path, notify is called when a batch starts */
+    IngestServer(const std::string& path, std::function<void()> notify);
+    ~IngestServer();
+
+    IngestServer(const IngestServer&) = delete;
+    IngestServer& operator=(const IngestServer&) = delete;
+
+    /** Minimum time between batches */
+    void setInterval(int64_t ns);
+
+    /** Seconds until the batch is due, negative if there is none */
+    double timeout() const;
+    /** Send the batch to browser's main frame if it is due */
+    void flush(CefRefPtr<CefBrowser> browser);
+};
+
+/**
+ * Render process side, exposing window.nanamo and delivering batches to its
+ * ondata handler.
+ */
+class IngestReceiver : public CefRenderProcessHandler {
+  public:
+    void OnContextCreated(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+                          CefRefPtr<CefV8Context>) override final;
+    bool OnProcessMessageReceived(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+                                  CefProcessId,
+                                  CefRefPtr<CefProcessMessage>) override final;
+
+    IMPLEMENT_REFCOUNTING(IngestReceiver);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_INGEST_HH_ */
@@ -0,0 +1,66 @@
+/** ingestfmt.hh -- Data ingest protocol definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_INGESTFMT_HH_
+#define NNM_INGESTFMT_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Producers connect to a SOCK_SEQPACKET Unix socket and send one message
+ * per packet, of at most INGEST_MAX_MESSAGE bytes. Nothing is sent back;
+ * while the page falls behind, nanamo stops reading and sends block.
+ *
+ * Once per frame, everything received since the last frame goes to the
+ * render process as an INGEST_MESSAGE process message, in shared memory
+ * where CEF supports it. Its data is an IngestRecord followed by that many
+ * payload bytes, then padding to a multiple of 8, for each message. The page
+ * gets the payloads as an array of ArrayBuffers:
+ *
+ *     window.nanamo.ondata = (buffers) => { ... };
+ *
+ * Messages arriving before ondata is set are dropped.
+ */
+
+namespace nanamo {
+
+static constexpr const char* INGEST_MESSAGE = "nanamo.ingest";
+static constexpr size_t INGEST_MAX_MESSAGE = 64 * 1024;
+
+struct IngestRecord {
+    uint32_t size;
+    uint32_t reserved;
+};
+
+/** Bytes a message of size bytes takes in a batch */
+constexpr size_t
+ingestRecordSize(size_t size)
+{
+    return sizeof(IngestRecord) + (size + 7) / 8 * 8;
+}
+
+} // namespace nanamo
+
+#endif /* NNM_INGESTFMT_HH_ */
@@ -0,0 +1,449 @@
+/** input.cc -- Input forwarding implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+
+#include <GLFW/glfw3.h>
+
+#include "input.hh"
+#include "stats.hh"
+
+namespace nanamo {
+
+/* Clicks closer than this in time and space count as a double click */
+static constexpr int64_t DOUBLE_CLICK_NS = 500'000'000;
+static constexpr double DOUBLE_CLICK_DISTANCE = 4.0;
+
+/* Pixels scrolled per wheel notch */
+static constexpr double WHEEL_STEP = 40.0;
+
+static uint32_t
+modifierFlags(int mods)
+{
+    uint32_t flags = EVENTFLAG_NONE;
+    if (mods & GLFW_MOD_SHIFT) {
+        flags |= EVENTFLAG_SHIFT_DOWN;
+    }
+    if (mods & GLFW_MOD_CONTROL) {
+        flags |= EVENTFLAG_CONTROL_DOWN;
+    }
+    if (mods & GLFW_MOD_ALT) {
+        flags |= EVENTFLAG_ALT_DOWN;
+    }
+    if (mods & GLFW_MOD_SUPER) {
+        flags |= EVENTFLAG_COMMAND_DOWN;
+    }
+    if (mods & GLFW_MOD_CAPS_LOCK) {
+        flags |= EVENTFLAG_CAPS_LOCK_ON;
+    }
+    if (mods & GLFW_MOD_NUM_LOCK) {
+        flags |= EVENTFLAG_NUM_LOCK_ON;
+    }
+    return flags;
+}
+
+/* Flag of a modifier key itself, which GLFW leaves out of its own event */
+static uint32_t
+modifierKeyFlag(int key)
+{
+    switch (key) {
+    case GLFW_KEY_LEFT_SHIFT:
+    case GLFW_KEY_RIGHT_SHIFT:
+        return EVENTFLAG_SHIFT_DOWN;
+    case GLFW_KEY_LEFT_CONTROL:
+    case GLFW_KEY_RIGHT_CONTROL:
+        return EVENTFLAG_CONTROL_DOWN;
+    case GLFW_KEY_LEFT_ALT:
+    case GLFW_KEY_RIGHT_ALT:
+        return EVENTFLAG_ALT_DOWN;
+    case GLFW_KEY_LEFT_SUPER:
+    case GLFW_KEY_RIGHT_SUPER:
+        return EVENTFLAG_COMMAND_DOWN;
+    default:
+        return EVENTFLAG_NONE;
+    }
+}
+
+static uint32_t
+buttonFlag(int button)
+{
+    switch (button) {
+    case GLFW_MOUSE_BUTTON_LEFT:
+        return EVENTFLAG_LEFT_MOUSE_BUTTON;
+    case GLFW_MOUSE_BUTTON_MIDDLE:
+        return EVENTFLAG_MIDDLE_MOUSE_BUTTON;
+    case GLFW_MOUSE_BUTTON_RIGHT:
+        return EVENTFLAG_RIGHT_MOUSE_BUTTON;
+    default:
+        return EVENTFLAG_NONE;
+    }
+}
+
+/* Location flags Chromium uses to tell left/right and keypad keys apart */
+static uint32_t
+locationFlag(int key)
+{
+    switch (key) {
+    case GLFW_KEY_LEFT_SHIFT:
+    case GLFW_KEY_LEFT_CONTROL:
+    case GLFW_KEY_LEFT_ALT:
+    case GLFW_KEY_LEFT_SUPER:
+        return EVENTFLAG_IS_LEFT;
+    case GLFW_KEY_RIGHT_SHIFT:
+    case GLFW_KEY_RIGHT_CONTROL:
+    case GLFW_KEY_RIGHT_ALT:
+    case GLFW_KEY_RIGHT_SUPER:
+        return EVENTFLAG_IS_RIGHT;
+    default:
+        if (key >= GLFW_KEY_KP_0 && key <= GLFW_KEY_KP_EQUAL) {
+            return EVENTFLAG_IS_KEY_PAD;
+        }
+        return EVENTFLAG_NONE;
+    }
+}
+
+/* Map a GLFW key to the Windows virtual key code CEF expects */
+static int
+windowsKeyCode(int key)
+{
+    if ((key >= GLFW_KEY_A && key <= GLFW_KEY_Z) ||
+        (key >= GLFW_KEY_0 && key <= GLFW_KEY_9) || key == GLFW_KEY_SPACE) {
+        /* These match ASCII, as do the VK codes */
+        return key;
+    }
+    if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F24) {
+        return 0x70 + (key - GLFW_KEY_F1);
+    }
+    if (key >= GLFW_KEY_KP_0 && key <= GLFW_KEY_KP_9) {
+        return 0x60 + (key - GLFW_KEY_KP_0);
+    }
+
+    switch (key) {
+    case GLFW_KEY_APOSTROPHE:
+        return 0xDE;
+    case GLFW_KEY_COMMA:
+        return 0xBC;
+    case GLFW_KEY_MINUS:
+        return 0xBD;
+    case GLFW_KEY_PERIOD:
+        return 0xBE;
+    case GLFW_KEY_SLASH:
+        return 0xBF;
+    case GLFW_KEY_SEMICOLON:
+        return 0xBA;
+    case GLFW_KEY_EQUAL:
+        return 0xBB;
+    case GLFW_KEY_LEFT_BRACKET:
+        return 0xDB;
+    case GLFW_KEY_BACKSLASH:
+        return 0xDC;
+    case GLFW_KEY_RIGHT_BRACKET:
+        return 0xDD;
+    case GLFW_KEY_GRAVE_ACCENT:
+        return 0xC0;
+    case GLFW_KEY_WORLD_1:
+    case GLFW_KEY_WORLD_2:
+        return 0xE2;
+    case GLFW_KEY_ESCAPE:
+        return 0x1B;
+    case GLFW_KEY_ENTER:
+    case GLFW_KEY_KP_ENTER:
+        return 0x0D;
+    case GLFW_KEY_TAB:
+        return 0x09;
+    case GLFW_KEY_BACKSPACE:
+        return 0x08;
+    case GLFW_KEY_INSERT:
+        return 0x2D;
+    case GLFW_KEY_DELETE:
+        return 0x2E;
+    case GLFW_KEY_RIGHT:
+        return 0x27;
+    case GLFW_KEY_LEFT:
+        return 0x25;
+    case GLFW_KEY_DOWN:
+        return 0x28;
+    case GLFW_KEY_UP:
+        return 0x26;
+    case GLFW_KEY_PAGE_UP:
+        return 0x21;
+    case GLFW_KEY_PAGE_DOWN:
+        return 0x22;
+    case GLFW_KEY_HOME:
+        return 0x24;
+    case GLFW_KEY_END:
+        return 0x23;
+    case GLFW_KEY_CAPS_LOCK:
+        return 0x14;
+    case GLFW_KEY_SCROLL_LOCK:
+        return 0x91;
+    case GLFW_KEY_NUM_LOCK:
+        return 0x90;
+    case GLFW_KEY_PRINT_SCREEN:
+        return 0x2C;
+    case GLFW_KEY_PAUSE:
+        return 0x13;
+    case GLFW_KEY_KP_DECIMAL:
+        return 0x6E;
+    case GLFW_KEY_KP_DIVIDE:
+        return 0x6F;
+    case GLFW_KEY_KP_MULTIPLY:
+        return 0x6A;
+    case GLFW_KEY_KP_SUBTRACT:
+        return 0x6D;
+    case GLFW_KEY_KP_ADD:
+        return 0x6B;
+    case GLFW_KEY_KP_EQUAL:
+        return 0xBB;
+    case GLFW_KEY_LEFT_SHIFT:
+    case GLFW_KEY_RIGHT_SHIFT:
+        return 0x10;
+    case GLFW_KEY_LEFT_CONTROL:
+    case GLFW_KEY_RIGHT_CONTROL:
+        return 0x11;
+    case GLFW_KEY_LEFT_ALT:
+    case GLFW_KEY_RIGHT_ALT:
+        return 0x12;
+    case GLFW_KEY_LEFT_SUPER:
+        return 0x5B;
+    case GLFW_KEY_RIGHT_SUPER:
+        return 0x5C;
+    case GLFW_KEY_MENU:
+        return 0x5D;
+    default:
+        return 0;
+    }
+}
+
+uint32_t
+InputQueue::m_modifiers() const
+{
+    return m_keyMods | m_buttons;
+}
+
+void
+InputQueue::m_push(Type type, bool urgent)
+{
+    m_events.push_back({type, m_x, m_y, m_modifiers()});
+    m_urgent = m_urgent || urgent;
+}
+
+void
+InputQueue::setInterval(int64_t ns)
+{
+    m_interval = ns;
+}
+
+void
+InputQueue::move(double x, double y)
+{
+    m_x = x;
+    m_y = y;
+    if (!m_events.empty() && m_events.back().type == Type::Move) {
+        Event& ev = m_events.back();
+        ev.x = x;
+        ev.y = y;
+        ev.modifiers = m_modifiers();
+        return;
+    }
+    m_push(Type::Move, false);
+}
+
+void
+InputQueue::leave()
+{
+    m_push(Type::Leave, true);
+}
+
+void
+InputQueue::button(int button, int action, int mods)
+{
+    uint32_t flag = buttonFlag(button);
+    if (flag == EVENTFLAG_NONE) {
+        /* CEF has no way to deliver extra buttons */
+        return;
+    }
+    m_keyMods = modifierFlags(mods);
+
+    if (action == GLFW_PRESS) {
+        int64_t now = Stats::now();
+        bool repeated = button == m_lastClickButton &&
+                        now - m_lastClickTime < DOUBLE_CLICK_NS &&
+                        std::hypot(m_x - m_lastClickX, m_y - m_lastClickY) <=
+                            DOUBLE_CLICK_DISTANCE;
+        m_clickCount = repeated ? m_clickCount + 1 : 1;
+        m_lastClickButton = button;
+        m_lastClickTime = now;
+        m_lastClickX = m_x;
+        m_lastClickY = m_y;
+        m_buttons |= flag;
+    } else {
+        m_buttons &= ~flag;
+    }
+
+    m_push(Type::Button, true);
+    Event& ev = m_events.back();
+    ev.code = button;
+    ev.action = action == GLFW_PRESS ? m_clickCount : 0;
+}
+
+void
+InputQueue::scroll(double dx, double dy)
+{
+    if (m_events.empty() || m_events.back().type != Type::Wheel) {
+        m_push(Type::Wheel, false);
+    }
+    Event& ev = m_events.back();
+    ev.dx += dx;
+    ev.dy += dy;
+}
+
+void
+InputQueue::key(int key, int scancode, int action, int mods)
+{
+    uint32_t flags = modifierFlags(mods);
+    if (action == GLFW_RELEASE) {
+        flags &= ~modifierKeyFlag(key);
+    } else {
+        flags |= modifierKeyFlag(key);
+    }
+    m_keyMods = flags;
+
+    m_push(Type::Key, true);
+    Event& ev = m_events.back();
+    ev.code = key;
+    ev.action = action;
+    ev.native = scancode;
+
+    if (action != GLFW_RELEASE &&
+        (key == GLFW_KEY_ENTER || key == GLFW_KEY_KP_ENTER)) {
+        /* GLFW has no character event for enter, but text fields want one */
+        character('\r');
+    }
+}
+
+void
+InputQueue::character(unsigned int codepoint)
+{
+    m_push(Type::Char, true);
+    m_events.back().code = codepoint;
+}
+
+double
+InputQueue::timeout() const
+{
+    if (m_events.empty()) {
+        return -1;
+    }
+    if (m_urgent) {
+        return 0;
+    }
+    int64_t due = m_lastFlush + m_interval - Stats::now();
+    return due > 0 ? due / 1e9 : 0;
+}
+
+void
+InputQueue::m_send(CefRefPtr<CefBrowserHost> host, const Event& ev)
+{
+    CefMouseEvent mouse;
+    mouse.x = ev.x;
+    mouse.y = ev.y;
+    mouse.modifiers = ev.modifiers;
+
+    switch (ev.type) {
+    case Type::Move:
+        host->SendMouseMoveEvent(mouse, false);
+        break;
+    case Type::Leave:
+        host->SendMouseMoveEvent(mouse, true);
+        break;
+    case Type::Button: {
+        MouseButtonType type = MBT_LEFT;
+        if (ev.code == GLFW_MOUSE_BUTTON_RIGHT) {
+            type = MBT_RIGHT;
+        } else if (ev.code == GLFW_MOUSE_BUTTON_MIDDLE) {
+            type = MBT_MIDDLE;
+        }
+        bool up = ev.action == 0;
+        host->SendMouseClickEvent(mouse, type, up, up ? 1 : ev.action);
+        break;
+    }
+    case Type::Wheel:
+        host->SendMouseWheelEvent(mouse, std::lround(ev.dx * WHEEL_STEP),
+                                  std::lround(ev.dy * WHEEL_STEP));
+        break;
+    case Type::Key: {
+        CefKeyEvent key;
+        key.type = ev.action == GLFW_RELEASE ? KEYEVENT_KEYUP
+                                             : KEYEVENT_RAWKEYDOWN;
+        key.modifiers = ev.modifiers | locationFlag(ev.code);
+        if (ev.action == GLFW_REPEAT) {
+            key.modifiers |= EVENTFLAG_IS_REPEAT;
+        }
+        key.windows_key_code = windowsKeyCode(ev.code);
+        key.native_key_code = ev.native;
+        host->SendKeyEvent(key);
+        break;
+    }
+    case Type::Char: {
+        /* Characters outside the BMP go out as a surrogate pair */
+        CefKeyEvent key;
+        key.type = KEYEVENT_CHAR;
+        key.modifiers = ev.modifiers;
+        if (ev.code > 0xFFFF) {
+            int c = ev.code - 0x10000;
+            key.character = key.unmodified_character = 0xD800 + (c >> 10);
+            key.windows_key_code = key.character;
+            host->SendKeyEvent(key);
+            key.character = key.unmodified_character = 0xDC00 + (c & 0x3FF);
+        } else {
+            key.character = key.unmodified_character = ev.code;
+        }
+        key.windows_key_code = key.character;
+        host->SendKeyEvent(key);
+        break;
+    }
+    }
+}
+
+void
+InputQueue::flush(CefRefPtr<CefBrowserHost> host)
+{
+    if (m_events.empty()) {
+        return;
+    }
+    int64_t now = Stats::now();
+    if (!m_urgent && now - m_lastFlush < m_interval) {
+        return;
+    }
+
+    for (const auto& ev : m_events) {
+        m_send(host, ev);
+    }
+    m_events.clear();
+    m_urgent = false;
+    m_lastFlush = now;
+}
+
+} // namespace nanamo
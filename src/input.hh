@@ -0,0 +1,98 @@
+/** input.hh -- Input forwarding definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_INPUT_HH_
+#define NNM_INPUT_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include <cef_browser.h>
+
+namespace nanamo {
+
+/**
+ * Queues GLFW input and forwards it to a browser in batches.
+ *
+ * Consecutive mouse moves collapse into the latest one, as do consecutive
+ * wheel events, while button and key events keep their order relative to
+ * everything else. Moves alone are flushed at most once per interval;
+ * anything else flushes on the next iteration.
+ */
+class InputQueue {
+  private:
+    enum class Type { Move, Leave, Button, Wheel, Key, Char };
+
+    struct Event {
+        Type type;
+        double x;
+        double y;
+        uint32_t modifiers;
+        int code = 0;   /* button, key or character */
+        int action = 0; /* GLFW action, or click count for buttons */
+        int native = 0; /* scancode */
+        double dx = 0;
+        double dy = 0;
+    };
+
+    std::vector<Event> m_events;
+    bool m_urgent = false;
+    int64_t m_interval = 0;
+    int64_t m_lastFlush = 0;
+
+    double m_x = 0;
+    double m_y = 0;
+    uint32_t m_buttons = 0;
+    uint32_t m_keyMods = 0;
+
+    int m_lastClickButton = -1;
+    int64_t m_lastClickTime = 0;
+    double m_lastClickX = 0;
+    double m_lastClickY = 0;
+    int m_clickCount = 0;
+
+    uint32_t m_modifiers() const;
+    void m_push(Type, bool urgent);
+    void m_send(CefRefPtr<CefBrowserHost>, const Event&);
+
+  public:
+    /** Minimum time between flushes of pending mouse moves */
+    void setInterval(int64_t ns);
+
+    void move(double x, double y);
+    void leave();
+    void button(int button, int action, int mods);
+    void scroll(double dx, double dy);
+    void key(int key, int scancode, int action, int mods);
+    void character(unsigned int codepoint);
+
+    /** Seconds until pending events are due, negative if there are none */
+    double timeout() const;
+    /** Send due events to host */
+    void flush(CefRefPtr<CefBrowserHost> host);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_INPUT_HH_ */
@@ -0,0 +1,174 @@
+/** loop.cc -- Main loop implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+
+#include "daemon.hh"
+#include "loop.hh"
+#include "stats.hh"
+#include "trace.hh"
+
+namespace nanamo {
+
+MainLoop::MainLoop(RenderContext& context, MessagePump& pump)
+    : m_context(context), m_pump(pump)
+{
+}
+
+int
+MainLoop::add(std::unique_ptr<Renderer> renderer)
+{
+    int id = m_nextId++;
+    m_renderers.emplace(id, std::move(renderer));
+    /* Let CEF get on with creating the browsers between overlays */
+    if (m_pump.due()) {
+        m_context.makeCurrent();
+        m_pump.doWork();
+    }
+    return id;
+}
+
+Renderer*
+MainLoop::find(int id)
+{
+    auto it = m_renderers.find(id);
+    return it != m_renderers.end() ? it->second.get() : nullptr;
+}
+
+bool
+MainLoop::remove(int id)
+{
+    return m_renderers.erase(id) > 0;
+}
+
+const std::map<int, std::unique_ptr<Renderer>>&
+MainLoop::renderers() const
+{
+    return m_renderers;
+}
+
+void
+MainLoop::serve(Daemon& daemon)
+{
+    m_daemon = &daemon;
+}
+
+void
+MainLoop::quitAfter(double seconds)
+{
+    m_deadline = Stats::now() + int64_t(seconds * 1e9);
+}
+
+void
+MainLoop::quit()
+{
+    m_quit = true;
+}
+
+double
+MainLoop::m_timeout() const
+{
+    double timeout = m_pump.timeout();
+    for (const auto& [id, renderer] : m_renderers) {
+        double input = renderer->inputTimeout();
+        if (input >= 0) {
+            timeout = std::min(timeout, input);
+        }
+    }
+    return timeout;
+}
+
+void
+MainLoop::run()
+{
+    /* Sleep until CEF wants work, GLFW has events or queued input is due,
+     * and only redraw when something on screen actually changed.
+     * Forwarding input makes CEF schedule work, which wakes us. */
+    m_pump.attach();
+    while ((m_daemon || !m_renderers.empty()) && !m_quit &&
+           Stats::now() < m_deadline) {
+        glfwWaitEventsTimeout(m_timeout());
+
+        TraceSpan span("mainLoop");
+        Stats* stats = Stats::get();
+        int64_t start = stats ? Stats::now() : 0;
+
+        std::erase_if(m_renderers,
+                      [](const auto& r) { return r.second->shouldClose(); });
+        if (m_daemon) {
+            m_daemon->process(*this);
+        }
+        for (auto& [id, renderer] : m_renderers) {
+            renderer->flushInput();
+        }
+
+        /* Paints are uploaded in CEF work, or taken from the overlays'
+         * mailboxes when CEF runs on its own thread */
+        bool work = m_pump.due();
+        bool frames = std::ranges::any_of(
+            m_renderers, [](const auto& r) { return r.second->frameReady(); });
+        if (work || frames) {
+            m_context.makeCurrent();
+            if (work) {
+                m_pump.doWork();
+            }
+            for (auto& [id, renderer] : m_renderers) {
+                renderer->takeFrame();
+            }
+            /* Make the uploads visible to the overlay contexts */
+            glFlush();
+        }
+
+        for (auto& [id, renderer] : m_renderers) {
+            renderer->frame();
+        }
+
+        if (stats) {
+            stats->loopIteration.record(Stats::now() - start);
+            stats->tick();
+        }
+    }
+    m_pump.detach();
+}
+
+void
+MainLoop::close()
+{
+    m_renderers.clear();
+
+    int64_t deadline = Stats::now() + CLOSE_TIMEOUT;
+    while (BrowserClient::openBrowsers() > 0 && Stats::now() < deadline) {
+        glfwWaitEventsTimeout(m_pump.timeout());
+        if (m_pump.due()) {
+            m_context.makeCurrent();
+            m_pump.doWork();
+        }
+    }
+    if (BrowserClient::openBrowsers() > 0) {
+        std::cerr << "Browsers still open at shutdown" << std::endl;
+    }
+}
+
+} // namespace nanamo
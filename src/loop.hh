@@ -0,0 +1,92 @@
+/** loop.hh -- Main loop definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_LOOP_HH_
+#define NNM_LOOP_HH_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include "pump.hh"
+#include "renderer.hh"
+
+namespace nanamo {
+
+class Daemon;
+
+/**
+ * Single event loop driving every overlay of the process.
+ *
+ * CEF work runs with the shared context current so paints upload into it,
+ * then each overlay with new content redraws in its own window.
+ */
+class MainLoop {
+  private:
+    /* Longest close() waits for browsers to close, in nanoseconds */
+    static constexpr int64_t CLOSE_TIMEOUT = 5'000'000'000;
+
+    RenderContext& m_context;
+    MessagePump& m_pump;
+    std::map<int, std::unique_ptr<Renderer>> m_renderers;
+    int m_nextId = 1;
+    int64_t m_deadline = INT64_MAX;
+    bool m_quit = false;
+    Daemon* m_daemon = nullptr;
+
+    double m_timeout() const;
+
+  public:
+    MainLoop(RenderContext&, MessagePump&);
+
+    /** Add an overlay, returning an id for it */
+    int add(std::unique_ptr<Renderer>);
+    /** Overlay by id, or null */
+    Renderer* find(int id);
+    /** Close an overlay, false if there is no such id */
+    bool remove(int id);
+    const std::map<int, std::unique_ptr<Renderer>>& renderers() const;
+
+    /** Run commands from daemon, and keep running without overlays */
+    void serve(Daemon& daemon);
+    /** Make run() return after the given number of seconds */
+    void quitAfter(double seconds);
+    /** Make run() return after the current iteration */
+    void quit();
+
+    /**
+     * Run until every overlay window has been closed, unless serving a
+     * daemon, or until the deadline or quit()
+     */
+    void run();
+    /**
+     * Close every overlay, then run CEF work until their browsers are
+     * closed, as CefShutdown() needs
+     */
+    void close();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_LOOP_HH_ */
@@ -0,0 +1,123 @@
+/** mailbox.cc -- Frame mailbox implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "mailbox.hh"
+
+namespace nanamo {
+
+static void
+copyRect(uint8_t* dst, const uint8_t* src, int width, int height,
+         const CefRect& rect)
+{
+    int x0 = std::max(rect.x, 0);
+    int y0 = std::max(rect.y, 0);
+    int x1 = std::min(rect.x + rect.width, width);
+    int y1 = std::min(rect.y + rect.height, height);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    size_t stride = size_t(width) * 4;
+    size_t offset = y0 * stride + size_t(x0) * 4;
+    size_t len = size_t(x1 - x0) * 4;
+    for (int y = y0; y < y1; y++, offset += stride) {
+        std::memcpy(dst + offset, src + offset, len);
+    }
+}
+
+void
+FrameMailbox::write(const RectList& dirtyRects, const void* data, int width,
+                    int height)
+{
+    Frame& frame = m_frames[m_back];
+    auto src = static_cast<const uint8_t*>(data);
+    size_t size = size_t(width) * height * 4;
+
+    if (m_pendingFull[m_back] || frame.width != width ||
+        frame.height != height) {
+        frame.pixels.assign(src, src + size);
+    } else {
+        for (const auto& rect : m_pending[m_back]) {
+            copyRect(frame.pixels.data(), src, width, height, rect);
+        }
+        for (const auto& rect : dirtyRects) {
+            copyRect(frame.pixels.data(), src, width, height, rect);
+        }
+    }
+    m_pending[m_back].clear();
+    m_pendingFull[m_back] = false;
+
+    /* The other buffers now miss this frame's changes */
+    bool resized = width != m_width || height != m_height;
+    m_width = width;
+    m_height = height;
+    for (int i = 0; i < BUFFERS; i++) {
+        if (i == m_back) {
+            continue;
+        }
+        auto& pending = m_pending[i];
+        pending.insert(pending.end(), dirtyRects.begin(), dirtyRects.end());
+        if (resized || pending.size() > MAX_PENDING) {
+            pending.clear();
+            m_pendingFull[i] = true;
+        }
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.sequence = ++m_sequence;
+    if (resized) {
+        frame.rects.assign(1, CefRect(0, 0, width, height));
+    } else {
+        frame.rects.assign(dirtyRects.begin(), dirtyRects.end());
+    }
+
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) &
+             ~FRESH;
+}
+
+bool
+FrameMailbox::ready() const
+{
+    return m_middle.load(std::memory_order_relaxed) & FRESH;
+}
+
+const FrameMailbox::Frame*
+FrameMailbox::read(bool& full)
+{
+    if (!ready()) {
+        return nullptr;
+    }
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~FRESH;
+
+    const Frame& frame = m_frames[m_front];
+    full = frame.sequence != m_lastRead + 1;
+    m_lastRead = frame.sequence;
+    return &frame;
+}
+
+} // namespace nanamo
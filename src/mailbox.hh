@@ -0,0 +1,99 @@
+/** mailbox.hh -- Frame mailbox definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_MAILBOX_HH_
+#define NNM_MAILBOX_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+namespace nanamo {
+
+/**
+ * Lock-free triple buffer handing painted frames from CEF's UI thread to
+ * the render loop.
+ *
+ * The writer fills its back buffer and swaps it with the middle one; the
+ * reader swaps its front buffer with the middle one when a newer frame is
+ * there. Neither ever waits, the reader just gets the latest frame. Only
+ * dirty regions are copied: the writer remembers, for each buffer, what
+ * changed since that buffer last held a frame.
+ */
+class FrameMailbox {
+  public:
+    typedef CefRenderHandler::RectList RectList;
+
+    struct Frame {
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        uint64_t sequence = 0;
+        /* Changed since frame sequence - 1 */
+        std::vector<CefRect> rects;
+    };
+
+  private:
+    static constexpr int BUFFERS = 3;
+    /* Set in m_middle when it holds a frame the reader has not taken */
+    static constexpr uint32_t FRESH = 4;
+    /* More pending rects than this are replaced by a full copy */
+    static constexpr size_t MAX_PENDING = 64;
+
+    Frame m_frames[BUFFERS];
+    std::atomic<uint32_t> m_middle = 1;
+
+    /* Writer side */
+    int m_back = 0;
+    uint64_t m_sequence = 0;
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<CefRect> m_pending[BUFFERS];
+    bool m_pendingFull[BUFFERS] = {true, true, true};
+
+    /* Reader side */
+    int m_front = 2;
+    uint64_t m_lastRead = 0;
+
+  public:
+    /** Publish the dirty parts of a width x height frame, writer only */
+    void write(const RectList& dirtyRects, const void* data, int width,
+               int height);
+
+    /** Whether a frame was written since the last read */
+    bool ready() const;
+    /**
+     * Take the latest frame, or null if there is none since the last read.
+     * full is set if frames were skipped since the previous read, making
+     * the rects of this one insufficient. The frame stays valid until the
+     * next read.
+     */
+    const Frame* read(bool& full);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_MAILBOX_HH_ */
@@ -22,36 +22,210 @@
  * SOFTWARE.
  */
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include <getopt.h>
 
 #include <cef_app.h>
 
+#include "app.hh"
+#include "bundle.hh"
+#include "daemon.hh"
+#include "headless.hh"
+#include "loop.hh"
+#include "probe.hh"
 #include "renderer.hh"
+#include "startup.hh"
+#include "stats.hh"
+#include "trace.hh"
 
 static bool ARG_border = false;
+static bool ARG_clickThrough = false;
+static int ARG_hitAlpha = 0;
 static bool ARG_resizable = false;
 static bool ARG_transparent = false;
-static std::string ARG_url = "";
+static std::vector<nanamo::Geometry> ARG_geometries;
+static std::vector<std::string> ARG_urls;
+static bool ARG_stats = false;
+static std::string ARG_statsFile = "";
+static double ARG_statsInterval = 5.0;
+static double ARG_exitAfter = 0.0;
+static nanamo::FrameRateOptions ARG_frameRate;
+static float ARG_renderScale = 1.0f;
+static float ARG_sharpness = 0.0f;
+static std::string ARG_export = "";
+static std::string ARG_ingest = "";
+static std::string ARG_trace = "";
+static std::string ARG_traceCategories = "";
+static bool ARG_headless = false;
+static bool ARG_offscreen = false;
+static std::string ARG_record = "";
+static bool ARG_threaded = false;
+static bool ARG_shrinkDamage = false;
+static bool ARG_beginFrames = false;
+static int ARG_swapInterval = -1;
+static bool ARG_startupReport = false;
+static int ARG_latencyProbe = 0;
+static std::vector<std::string> ARG_bundles;
+static std::string ARG_cachePath = "/tmp/nanamo-cache";
+static bool ARG_egl = false;
+static std::optional<nanamo::Profile> ARG_profile;
+static std::vector<std::pair<std::string, std::string>> ARG_cefSwitches;
+static bool ARG_daemon = false;
+static std::string ARG_daemonSocket = "";
+
+/* Values for options that only have a long form */
+enum {
+    OPT_STATS = 256,
+    OPT_STATS_INTERVAL,
+    OPT_EXIT_AFTER,
+    OPT_FPS,
+    OPT_IDLE_FPS,
+    OPT_IDLE_TIMEOUT,
+    OPT_UNFOCUSED_FPS,
+    OPT_RENDER_SCALE,
+    OPT_SHARPEN,
+    OPT_EXPORT,
+    OPT_HEADLESS,
+    OPT_RECORD,
+    OPT_DAEMON,
+    OPT_THREADED,
+    OPT_EGL,
+    OPT_PROFILE,
+    OPT_CEF_SWITCH,
+    OPT_INGEST,
+    OPT_TRACE,
+    OPT_TRACE_CATEGORIES,
+    OPT_OFFSCREEN,
+    OPT_SHRINK_DAMAGE,
+    OPT_BEGIN_FRAMES,
+    OPT_SWAP_INTERVAL,
+    OPT_STARTUP_REPORT,
+    OPT_LATENCY_PROBE,
+    OPT_BUNDLE,
+    OPT_CACHE_PATH,
+};
 
 static const char* cmdName = "nanamo";
 
 static void
 usage(std::ostream& os = std::cout)
 {
-    os << "usage: " << cmdName << " [options]" << std::endl;
+    os << "usage: " << cmdName << " [options] <url>..." << std::endl;
+    os << "       " << cmdName << " --daemon[=SOCKET] [options] [url]..."
+       << std::endl;
     os << "  options:" << std::endl;
     os << "    -b, --border\t"
        << "Enable window border" << std::endl;
+    os << "    -c, --click-through[=ALPHA]\t"
+       << "Pass input through where page alpha is at most ALPHA (default 0)"
+       << std::endl;
+    os << "    -g, --geometry=WxH[+X+Y]\t"
+       << "Window geometry, the n-th one applies to the n-th url" << std::endl;
     os << "    -h, --help\t\t"
        << "Show this help message" << std::endl;
     os << "    -r, --resizable\t"
        << "Make window resizable" << std::endl;
     os << "    -t, --transparent\t"
        << "Enable transparent background" << std::endl;
+    os << "    --stats[=FILE]\t"
+       << "Report performance statistics to stderr, or as JSON lines to FILE"
+       << std::endl;
+    os << "    --stats-interval=SEC\t"
+       << "Seconds between statistics reports (default 5)" << std::endl;
+    os << "    --exit-after=SEC\t"
+       << "Quit after running for SEC seconds" << std::endl;
+    os << "    --fps=N|auto\t"
+       << "Browser frame rate, auto follows the monitor (default 60)"
+       << std::endl;
+    os << "    --idle-fps=N\t"
+       << "Frame rate once the page stops painting, 0 disables (default 15)"
+       << std::endl;
+    os << "    --idle-timeout=SEC\t"
+       << "Seconds without paints before going idle (default 5)"
+       << std::endl;
+    os << "    --unfocused-fps=N\t"
+       << "Frame rate while the window is unfocused (default unchanged)"
+       << std::endl;
+    os << "    --render-scale=S\t"
+       << "Rasterize pages at S times window resolution (default 1)"
+       << std::endl;
+    os << "    --sharpen=AMOUNT\t"
+       << "Sharpen scaled pages by AMOUNT, from 0 to 1 (default 0)"
+       << std::endl;
+    os << "    --export=SOCKET\t"
+       << "Share frames with clients of SOCKET, suffixed .N for the n-th url"
+       << std::endl;
+    os << "    --headless\t\t"
+       << "Run without windows, only exporting or recording frames"
+       << std::endl;
+    os << "    --offscreen\t\t"
+       << "Run without windows or a display, drawing frames offscreen"
+       << std::endl;
+    os << "    --record=FILE\t"
+       << "Record paints to FILE without windows, suffixed .N for the n-th url"
+       << std::endl;
+    os << "    --daemon[=SOCKET]\t"
+       << "Keep running and take commands from nanamoctl on SOCKET"
+       << std::endl;
+    os << "    --threaded\t\t"
+       << "Run CEF on its own thread, apart from rendering" << std::endl;
+    os << "    --shrink-damage\t"
+       << "Compare paints with the last frame, pass on only changed tiles"
+       << std::endl;
+    os << "    --begin-frames\t"
+       << "Pace the browser's frames by presents, with external BeginFrames"
+       << std::endl;
+    os << "    --swap-interval=N\t"
+       << "Wait for N vblanks per swap, 0 never (default driver's)"
+       << std::endl;
+    os << "    --egl\t\t"
+       << "Create GL contexts through EGL, for partial swaps on X11"
+       << std::endl;
+    os << "    --profile=NAME\t"
+       << "Chromium tuning: lean, balanced or quality (default none)"
+       << std::endl;
+    os << "    --cef-switch=NAME[=VALUE]\t"
+       << "Pass a switch to Chromium, may be repeated" << std::endl;
+    os << "    --ingest=SOCKET\t"
+       << "Take data for the page on SOCKET, suffixed .N for the n-th url"
+       << std::endl;
+    os << "    --trace=FILE\t"
+       << "Write a Chromium and nanamo trace to FILE on exit" << std::endl;
+    os << "    --trace-categories=LIST\t"
+       << "Chromium trace categories (default Chromium's own)" << std::endl;
+    os << "    --startup-report\t"
+       << "Print how long startup took, up to each overlay's first frame"
+       << std::endl;
+    os << "    --latency-probe=N\t"
+       << "Click a probe page N times, print the click to present latency"
+       << std::endl;
+    os << "    --bundle=FILE\t"
+       << "Serve FILE from nanamo-pack as nanamo://NAME/, NAME its base name"
+       << std::endl;
+    os << "    --cache-path=DIR\t"
+       << "Browser cache, empty keeps it in memory (default /tmp/nanamo-cache)"
+       << std::endl;
+}
+
+static int
+parseRate(const char* str, bool allowZero = false)
+{
+    char* end;
+    long rate = std::strtol(str, &end, 10);
+    if (*end != '\0' || rate < (allowZero ? 0 : 1) || rate > 1000) {
+        std::cerr << "error: bad frame rate " << str << std::endl;
+        std::exit(-1);
+    }
+    return rate;
 }
 
 static void
@@ -59,14 +233,45 @@ parseArgs(int argc, char** argv)
 {
     static struct option longOpts[] = {
         {"border", 0, nullptr, 'b'},
+        {"click-through", 2, nullptr, 'c'},
+        {"geometry", 1, nullptr, 'g'},
         {"help", 0, nullptr, 'h'},
         {"resizable", 0, nullptr, 'r'},
         {"transparent", 0, nullptr, 't'},
+        {"stats", 2, nullptr, OPT_STATS},
+        {"stats-interval", 1, nullptr, OPT_STATS_INTERVAL},
+        {"exit-after", 1, nullptr, OPT_EXIT_AFTER},
+        {"fps", 1, nullptr, OPT_FPS},
+        {"idle-fps", 1, nullptr, OPT_IDLE_FPS},
+        {"idle-timeout", 1, nullptr, OPT_IDLE_TIMEOUT},
+        {"unfocused-fps", 1, nullptr, OPT_UNFOCUSED_FPS},
+        {"render-scale", 1, nullptr, OPT_RENDER_SCALE},
+        {"sharpen", 1, nullptr, OPT_SHARPEN},
+        {"export", 1, nullptr, OPT_EXPORT},
+        {"headless", 0, nullptr, OPT_HEADLESS},
+        {"offscreen", 0, nullptr, OPT_OFFSCREEN},
+        {"shrink-damage", 0, nullptr, OPT_SHRINK_DAMAGE},
+        {"begin-frames", 0, nullptr, OPT_BEGIN_FRAMES},
+        {"swap-interval", 1, nullptr, OPT_SWAP_INTERVAL},
+        {"record", 1, nullptr, OPT_RECORD},
+        {"daemon", 2, nullptr, OPT_DAEMON},
+        {"threaded", 0, nullptr, OPT_THREADED},
+        {"egl", 0, nullptr, OPT_EGL},
+        {"profile", 1, nullptr, OPT_PROFILE},
+        {"cef-switch", 1, nullptr, OPT_CEF_SWITCH},
+        {"ingest", 1, nullptr, OPT_INGEST},
+        {"trace", 1, nullptr, OPT_TRACE},
+        {"trace-categories", 1, nullptr, OPT_TRACE_CATEGORIES},
+        {"startup-report", 0, nullptr, OPT_STARTUP_REPORT},
+        {"latency-probe", 1, nullptr, OPT_LATENCY_PROBE},
+        {"bundle", 1, nullptr, OPT_BUNDLE},
+        {"cache-path", 1, nullptr, OPT_CACHE_PATH},
+        {nullptr, 0, nullptr, 0},
     };
 
     bool running = true;
     while (running) {
-        int c = getopt_long(argc, argv, "bhrt", longOpts, nullptr);
+        int c = getopt_long(argc, argv, "bc::g:hrt", longOpts, nullptr);
         switch (c) {
         case -1:
             running = false;
@@ -74,6 +279,24 @@ parseArgs(int argc, char** argv)
         case 'b':
             ARG_border = true;
             break;
+        case 'c':
+            ARG_clickThrough = true;
+            ARG_hitAlpha = optarg ? std::atoi(optarg) : 0;
+            if (ARG_hitAlpha < 0 || ARG_hitAlpha > 255) {
+                std::cerr << "error: bad alpha threshold " << optarg
+                          << std::endl;
+                std::exit(-1);
+            }
+            break;
+        case 'g': {
+            nanamo::Geometry geometry;
+            if (!nanamo::parseGeometry(optarg, geometry)) {
+                std::cerr << "error: bad geometry " << optarg << std::endl;
+                std::exit(-1);
+            }
+            ARG_geometries.push_back(geometry);
+            break;
+        }
         case 'h':
             usage();
             std::exit(0);
@@ -83,6 +306,163 @@ parseArgs(int argc, char** argv)
         case 't':
             ARG_transparent = true;
             break;
+        case OPT_STATS:
+            ARG_stats = true;
+            ARG_statsFile = optarg ? optarg : "";
+            break;
+        case OPT_STATS_INTERVAL:
+            ARG_statsInterval = std::atof(optarg);
+            if (ARG_statsInterval <= 0) {
+                std::cerr << "error: bad stats interval " << optarg
+                          << std::endl;
+                std::exit(-1);
+            }
+            break;
+        case OPT_EXIT_AFTER:
+            ARG_exitAfter = std::atof(optarg);
+            if (ARG_exitAfter <= 0) {
+                std::cerr << "error: bad duration " << optarg << std::endl;
+                std::exit(-1);
+            }
+            break;
+        case OPT_FPS:
+            if (std::string_view(optarg) == "auto") {
+                ARG_frameRate.fps = 0;
+            } else {
+                ARG_frameRate.fps = parseRate(optarg);
+            }
+            break;
+        case OPT_IDLE_FPS:
+            ARG_frameRate.idleFps = parseRate(optarg, true);
+            break;
+        case OPT_IDLE_TIMEOUT: {
+            char* end;
+            double timeout = std::strtod(optarg, &end);
+            if (*end != '\0' || !(timeout > 0)) {
+                std::cerr << "error: bad idle timeout " << optarg
+                          << std::endl;
+                std::exit(-1);
+            }
+            ARG_frameRate.idleTimeout = timeout;
+            break;
+        }
+        case OPT_UNFOCUSED_FPS:
+            ARG_frameRate.unfocusedFps = parseRate(optarg, true);
+            break;
+        case OPT_RENDER_SCALE:
+            ARG_renderScale = std::atof(optarg);
+            if (ARG_renderScale < 0.25 || ARG_renderScale > 4) {
+                std::cerr << "error: render scale must be between 0.25 and 4"
+                          << std::endl;
+                std::exit(-1);
+            }
+            break;
+        case OPT_SHARPEN:
+            ARG_sharpness = std::atof(optarg);
+            if (ARG_sharpness < 0 || ARG_sharpness > 1) {
+                std::cerr << "error: sharpen amount must be between 0 and 1"
+                          << std::endl;
+                std::exit(-1);
+            }
+            break;
+        case OPT_EXPORT:
+            ARG_export = optarg;
+            break;
+        case OPT_INGEST:
+            ARG_ingest = optarg;
+            break;
+        case OPT_TRACE:
+            ARG_trace = optarg;
+            break;
+        case OPT_TRACE_CATEGORIES:
+            ARG_traceCategories = optarg;
+            break;
+        case OPT_STARTUP_REPORT:
+            ARG_startupReport = true;
+            break;
+        case OPT_LATENCY_PROBE: {
+            char* end;
+            long count = std::strtol(optarg, &end, 10);
+            if (*end != '\0' || count <= 0 || count > 1000000) {
+                std::cerr << "error: bad click count " << optarg
+                          << std::endl;
+                std::exit(-1);
+            }
+            ARG_latencyProbe = count;
+            break;
+        }
+        case OPT_BUNDLE:
+            ARG_bundles.emplace_back(optarg);
+            break;
+        case OPT_CACHE_PATH:
+            ARG_cachePath = optarg;
+            break;
+        case OPT_HEADLESS:
+            ARG_headless = true;
+            break;
+        case OPT_OFFSCREEN:
+            ARG_offscreen = true;
+            ARG_headless = true;
+            break;
+        case OPT_SHRINK_DAMAGE:
+            ARG_shrinkDamage = true;
+            break;
+        case OPT_BEGIN_FRAMES:
+            ARG_beginFrames = true;
+            break;
+        case OPT_SWAP_INTERVAL: {
+            char* end;
+            long interval = std::strtol(optarg, &end, 10);
+            if (*end != '\0' || interval < 0 || interval > 4) {
+                std::cerr << "error: bad swap interval " << optarg
+                          << std::endl;
+                std::exit(-1);
+            }
+            ARG_swapInterval = interval;
+            break;
+        }
+        case OPT_RECORD:
+            ARG_record = optarg;
+            ARG_headless = true;
+            break;
+        case OPT_DAEMON:
+            ARG_daemon = true;
+            ARG_daemonSocket =
+                optarg ? optarg : nanamo::defaultDaemonSocket();
+            break;
+        case OPT_THREADED:
+            ARG_threaded = true;
+            break;
+        case OPT_EGL:
+            ARG_egl = true;
+            break;
+        case OPT_PROFILE: {
+            nanamo::Profile profile;
+            if (!nanamo::parseProfile(optarg, profile)) {
+                std::cerr << "error: bad profile " << optarg << std::endl;
+                std::exit(-1);
+            }
+            ARG_profile = profile;
+            break;
+        }
+        case OPT_CEF_SWITCH: {
+            std::string_view arg = optarg;
+            while (arg.starts_with('-')) {
+                arg.remove_prefix(1);
+            }
+            size_t eq = arg.find('=');
+            if (arg.empty() || eq == 0) {
+                std::cerr << "error: bad switch " << optarg << std::endl;
+                std::exit(-1);
+            }
+            if (eq == arg.npos) {
+                ARG_cefSwitches.emplace_back(arg, "");
+            } else {
+                ARG_cefSwitches.emplace_back(arg.substr(0, eq),
+                                             arg.substr(eq + 1));
+            }
+            break;
+        }
         case '?':
             usage(std::cerr);
             std::exit(-1);
@@ -92,23 +472,129 @@ parseArgs(int argc, char** argv)
         }
     }
 
-    if (argc - optind != 1) {
-        if (optind >= argc) {
-            std::cerr << "error: not enough arguments" << std::endl;
-        } else {
-            std::cerr << "error: too many arugments" << std::endl;
+    if (ARG_latencyProbe) {
+        if (optind < argc) {
+            std::cerr << "error: --latency-probe loads its own page"
+                      << std::endl;
+            std::exit(-1);
         }
+        ARG_urls.assign(1, nanamo::LatencyProbe::PAGE_URL);
+    } else if (optind >= argc && !ARG_daemon) {
+        std::cerr << "error: not enough arguments" << std::endl;
+        usage(std::cerr);
+        std::exit(-1);
+    } else {
+        ARG_urls.assign(argv + optind, argv + argc);
+    }
+
+    if (ARG_geometries.size() > ARG_urls.size()) {
+        std::cerr << "error: more geometries than urls" << std::endl;
         usage(std::cerr);
         std::exit(-1);
     }
-    ARG_url = argv[optind];
+    ARG_geometries.resize(ARG_urls.size());
+
+    if (ARG_headless && !ARG_offscreen && ARG_export.empty() &&
+        ARG_record.empty()) {
+        std::cerr << "error: --headless needs --export or --record"
+                  << std::endl;
+        std::exit(-1);
+    }
+    if (ARG_headless && !ARG_ingest.empty()) {
+        std::cerr << "error: --ingest needs windows" << std::endl;
+        std::exit(-1);
+    }
+    if (ARG_headless && ARG_beginFrames) {
+        std::cerr << "error: --begin-frames needs windows" << std::endl;
+        std::exit(-1);
+    }
+    if (ARG_headless && ARG_daemon) {
+        std::cerr << "error: --daemon needs windows" << std::endl;
+        std::exit(-1);
+    }
+    if (ARG_latencyProbe && (ARG_headless || ARG_daemon)) {
+        std::cerr << "error: --latency-probe needs a window of its own"
+                  << std::endl;
+        std::exit(-1);
+    }
 }
 
+/* Per-url file name for options taking one path for all urls */
+static std::string
+indexedPath(const std::string& path, size_t index)
+{
+    if (path.empty() || ARG_urls.size() == 1) {
+        return path;
+    }
+    return path + "." + std::to_string(index);
+}
+
+/* Options shared by every overlay */
+static nanamo::RendererOptions
+baseOptions()
+{
+    return {
+        .border = ARG_border,
+        .resizable = ARG_resizable,
+        .transparent = ARG_transparent,
+        .frameRate = ARG_frameRate,
+        .renderScale = ARG_renderScale,
+        .sharpness = ARG_sharpness,
+        .clickThrough = ARG_clickThrough,
+        .hitAlpha = uint8_t(ARG_hitAlpha),
+        .shrinkDamage = ARG_shrinkDamage,
+        .beginFrames = ARG_beginFrames,
+        .swapInterval = ARG_swapInterval,
+        .latencyProbe = ARG_latencyProbe,
+        .threaded = ARG_threaded,
+    };
+}
+
+static nanamo::RendererOptions
+rendererOptions(size_t index)
+{
+    const nanamo::Geometry& geometry = ARG_geometries[index];
+    nanamo::RendererOptions opts = baseOptions();
+    opts.url = ARG_urls[index];
+    opts.width = geometry.width;
+    opts.height = geometry.height;
+    opts.positioned = geometry.positioned;
+    opts.x = geometry.x;
+    opts.y = geometry.y;
+    opts.exportPath = indexedPath(ARG_export, index);
+    opts.ingestPath = indexedPath(ARG_ingest, index);
+    opts.recordPath = indexedPath(ARG_record, index);
+    return opts;
+}
+
+/* Create an Overlay per url, with any extra constructor arguments, run them
+ * and close them again */
+template <typename Overlay, typename Loop, typename... Context>
 static void
-startCEF(int argc, char* argv[])
+runOverlays(Loop& loop, Context&... context)
+{
+    for (size_t i = 0; i < ARG_urls.size(); i++) {
+        loop.add(std::make_unique<Overlay>(rendererOptions(i), context...));
+    }
+
+    if (ARG_exitAfter > 0) {
+        loop.quitAfter(ARG_exitAfter);
+    }
+
+    try {
+        loop.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Exception thrown from main loop: " << e.what()
+                  << std::endl;
+    }
+    loop.close();
+}
+
+static void
+startCEF(int argc, char* argv[], CefRefPtr<nanamo::App> app)
 {
     CefMainArgs args(argc, argv);
-    auto result = CefExecuteProcess(args, nullptr, nullptr);
+    auto result = CefExecuteProcess(args, app, nullptr);
     if (result == -1) {
         /* Called for the browser process. */
     } else if (result >= 0) {
@@ -118,37 +604,119 @@ startCEF(int argc, char* argv[])
 
     CefSettings settings;
     settings.windowless_rendering_enabled = true;
-    CefString(&settings.cache_path) = "/tmp/nanamo-cache";
+    if (ARG_threaded) {
+        /* Browser work and presentation no longer wait on each other */
+        settings.multi_threaded_message_loop = true;
+        app->pump().setMultiThreaded();
+    } else {
+        settings.external_message_pump = true;
+    }
+    /* Empty keeps everything in memory */
+    CefString(&settings.cache_path) = ARG_cachePath;
 
-    CefInitialize(args, settings, nullptr, nullptr);
+    CefInitialize(args, settings, app, nullptr);
 }
 
 int
 main(int argc, char* argv[])
 {
-    if (std::string_view(argv[1]).starts_with("--type")) {
+    if (argc > 1 && std::string_view(argv[1]).starts_with("--type")) {
         /* This is a CEF helper process, skip argument parsing */
     } else {
         parseArgs(argc, argv);
+        if (ARG_startupReport) {
+            nanamo::StartupReport::enable();
+        }
     }
 
-    startCEF(argc, argv);
+    CefRefPtr<nanamo::App> app = new nanamo::App();
+    if (ARG_profile) {
+        app->setProfile(*ARG_profile);
+    }
+    for (const auto& [name, value] : ARG_cefSwitches) {
+        app->addSwitch(name, value);
+    }
+    startCEF(argc, argv, app);
+    if (auto startup = nanamo::StartupReport::get()) {
+        startup->mark("cef initialize");
+    }
+    for (const auto& path : ARG_bundles) {
+        try {
+            nanamo::serveBundle(path);
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << e.what() << std::endl;
+            std::exit(-1);
+        }
+    }
 
-    nanamo::RendererOptions options = {
-        .border = ARG_border,
-        .resizable = ARG_resizable,
-        .transparent = ARG_transparent,
-        .url = ARG_url,
-    };
+    if (ARG_stats) {
+        try {
+            nanamo::Stats::enable(ARG_statsFile, ARG_statsInterval);
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << e.what() << std::endl;
+            std::exit(-1);
+        }
+    }
+    if (!ARG_trace.empty()) {
+        try {
+            nanamo::Tracer::enable(ARG_trace, ARG_traceCategories);
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << e.what() << std::endl;
+            std::exit(-1);
+        }
+    }
 
-    nanamo::Renderer renderer(options);
+    if (ARG_offscreen) {
+        std::optional<nanamo::RenderContext> context;
+        try {
+            context.emplace(nanamo::ContextApi::SURFACELESS);
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << e.what() << std::endl;
+            std::exit(-1);
+        }
+        if (auto startup = nanamo::StartupReport::get()) {
+            startup->mark("gl context");
+        }
+        nanamo::HeadlessLoop loop(app->pump(), &*context);
+        runOverlays<nanamo::HeadlessOverlay>(loop, *context, app->pump());
+    } else if (ARG_headless) {
+        nanamo::HeadlessLoop loop(app->pump());
+        runOverlays<nanamo::HeadlessOverlay>(loop);
+    } else {
+        nanamo::RenderContext context(ARG_egl ? nanamo::ContextApi::EGL
+                                              : nanamo::ContextApi::NATIVE);
+        if (auto startup = nanamo::StartupReport::get()) {
+            startup->mark("gl context");
+        }
+        nanamo::MainLoop loop(context, app->pump());
 
-    try {
-        renderer.mainLoop();
-    } catch (const std::exception& e) {
-        std::cerr << "Exception thrown from main loop: " << e.what()
-                  << std::endl;
+        std::optional<nanamo::Daemon> daemon;
+        if (ARG_daemon) {
+            try {
+                daemon.emplace(ARG_daemonSocket, baseOptions(), context,
+                               app->pump());
+            } catch (const std::exception& e) {
+                std::cerr << "error: " << e.what() << std::endl;
+                std::exit(-1);
+            }
+            loop.serve(*daemon);
+        }
+
+        runOverlays<nanamo::Renderer>(loop, context);
     }
 
+    if (auto startup = nanamo::StartupReport::get()) {
+        startup->finish();
+    }
+    if (auto stats = nanamo::Stats::get()) {
+        stats->report();
+    }
+    if (auto tracer = nanamo::Tracer::get()) {
+        try {
+            tracer->finish(app->pump());
+        } catch (const std::exception& e) {
+            std::cerr << "error: " << e.what() << std::endl;
+        }
+    }
     CefShutdown();
 }
@@ -0,0 +1,177 @@
+/** memory.cc -- Process memory accounting implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <utility>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "memory.hh"
+
+namespace nanamo {
+
+static std::string
+procPath(pid_t pid, const char* file)
+{
+    return "/proc/" + std::to_string(pid) + "/" + file;
+}
+
+/* Append the children of every thread of pid to tree */
+static void
+addChildren(pid_t pid, std::vector<pid_t>& tree)
+{
+    std::string taskDir = procPath(pid, "task");
+    DIR* dir = opendir(taskDir.c_str());
+    if (!dir) {
+        /* Exited meanwhile */
+        return;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::ifstream in(taskDir + "/" + entry->d_name + "/children");
+        pid_t child;
+        while (in >> child) {
+            tree.push_back(child);
+        }
+    }
+    closedir(dir);
+}
+
+static std::string
+processType(pid_t pid)
+{
+    std::ifstream in(procPath(pid, "cmdline"));
+    std::string arg;
+    while (std::getline(in, arg, '\0')) {
+        if (arg.starts_with("--type=")) {
+            return arg.substr(7);
+        }
+    }
+    return "browser";
+}
+
+static void
+addMemory(pid_t pid, ProcessMemory& memory)
+{
+    unsigned long long rss = 0, pss = 0;
+    bool found = false;
+
+    std::ifstream rollup(procPath(pid, "smaps_rollup"));
+    std::string line;
+    while (std::getline(rollup, line)) {
+        unsigned long long kb;
+        if (std::sscanf(line.c_str(), "Rss: %llu kB", &kb) == 1) {
+            rss = kb * 1024;
+            found = true;
+        } else if (std::sscanf(line.c_str(), "Pss: %llu kB", &kb) == 1) {
+            pss = kb * 1024;
+        }
+    }
+
+    if (!found) {
+        /* Before Linux 4.14, fall back to RSS alone */
+        std::ifstream statm(procPath(pid, "statm"));
+        unsigned long long size, pages;
+        if (!(statm >> size >> pages)) {
+            /* Exited meanwhile */
+            return;
+        }
+        rss = pages * sysconf(_SC_PAGESIZE);
+    }
+
+    memory.processes++;
+    memory.rss += rss;
+    memory.pss += pss;
+}
+
+std::vector<ProcessMemory>
+sampleProcessTree()
+{
+    /* Breadth-first, children are appended as their parents are visited */
+    std::vector<pid_t> tree = {getpid()};
+    for (size_t i = 0; i < tree.size(); i++) {
+        addChildren(tree[i], tree);
+    }
+
+    std::map<std::string, ProcessMemory> byType;
+    for (pid_t pid : tree) {
+        std::string type = processType(pid);
+        ProcessMemory& memory = byType[type];
+        memory.type = type;
+        addMemory(pid, memory);
+    }
+
+    std::vector<ProcessMemory> result;
+    for (auto& [type, memory] : byType) {
+        if (memory.processes) {
+            result.push_back(std::move(memory));
+        }
+    }
+    return result;
+}
+
+MemorySampler::MemorySampler(int64_t interval)
+    : m_interval(interval), m_thread(&MemorySampler::m_run, this)
+{
+}
+
+MemorySampler::~MemorySampler()
+{
+    {
+        std::unique_lock guard(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void
+MemorySampler::m_run()
+{
+    for (;;) {
+        std::vector<ProcessMemory> sample = sampleProcessTree();
+
+        std::unique_lock guard(m_lock);
+        m_latest = std::move(sample);
+        if (m_wake.wait_for(guard, std::chrono::nanoseconds(m_interval),
+                            [this] { return m_stopping; })) {
+            return;
+        }
+    }
+}
+
+std::vector<ProcessMemory>
+MemorySampler::latest()
+{
+    std::unique_lock guard(m_lock);
+    return m_latest;
+}
+
+} // namespace nanamo
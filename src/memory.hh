@@ -0,0 +1,87 @@
+/** memory.hh -- Process memory accounting definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_MEMORY_HH_
+#define NNM_MEMORY_HH_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nanamo {
+
+/** Memory of the processes of one type, in bytes */
+struct ProcessMemory {
+    std::string type;
+    int processes = 0;
+    uint64_t rss = 0;
+    /* Zero where the kernel has no smaps_rollup */
+    uint64_t pss = 0;
+};
+
+/**
+ * Sum the memory of this process and its descendants from /proc, grouped
+ * by Chromium process type (renderer, gpu-process, ...; browser for ours).
+ * PSS divides shared pages among the processes mapping them, so unlike RSS
+ * it adds up to what the tree really costs.
+ */
+std::vector<ProcessMemory> sampleProcessTree();
+
+/**
+ * Runs sampleProcessTree() on a thread of its own every interval.
+ *
+ * Reading smaps_rollup of Chromium's processes is slow and takes their
+ * mmap locks, far too much for a thread that presents frames.
+ */
+class MemorySampler {
+  private:
+    int64_t m_interval;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+    std::vector<ProcessMemory> m_latest;
+
+    std::thread m_thread;
+
+    void m_run();
+
+  public:
+    /** Sample every interval nanoseconds, starting right away */
+    explicit MemorySampler(int64_t interval);
+    ~MemorySampler();
+
+    MemorySampler(const MemorySampler&) = delete;
+    MemorySampler& operator=(const MemorySampler&) = delete;
+
+    /** The latest sample, empty before the first one is done */
+    std::vector<ProcessMemory> latest();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_MEMORY_HH_ */
@@ -0,0 +1,253 @@
+/** present.cc -- Damage-aware presentation implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "present.hh"
+
+#ifdef NNM_WITH_GLX
+#    define GLFW_EXPOSE_NATIVE_X11
+#    define GLFW_EXPOSE_NATIVE_GLX
+#endif
+#ifdef NNM_WITH_EGL
+#    define GLFW_EXPOSE_NATIVE_EGL
+#endif
+#if defined(NNM_WITH_GLX) || defined(NNM_WITH_EGL)
+#    include <GLFW/glfw3native.h>
+#endif
+#ifdef NNM_WITH_EGL
+#    include <EGL/eglext.h>
+#endif
+
+namespace nanamo {
+
+struct Presenter::Native {
+#ifdef NNM_WITH_GLX
+    Display* glxDisplay = nullptr;
+    GLXDrawable glxDrawable = 0;
+#endif
+#ifdef NNM_WITH_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLSurface eglSurface = EGL_NO_SURFACE;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapWithDamage = nullptr;
+    PFNEGLSETDAMAGEREGIONKHRPROC setDamageRegion = nullptr;
+#endif
+    bool bufferAge = false;
+};
+
+bool
+hasExtension(const char* list, const char* name)
+{
+    if (!list) {
+        return false;
+    }
+    size_t len = std::strlen(name);
+    for (const char* p = list; (p = std::strstr(p, name)); p += len) {
+        bool start = p == list || p[-1] == ' ';
+        bool end = p[len] == ' ' || p[len] == '\0';
+        if (start && end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Presenter::Presenter(GLFWwindow* window)
+    : m_window(window), m_native(std::make_unique<Native>())
+{
+    [[maybe_unused]] int api =
+        glfwGetWindowAttrib(window, GLFW_CONTEXT_CREATION_API);
+
+#ifdef NNM_WITH_EGL
+    if (api == GLFW_EGL_CONTEXT_API) {
+        EGLDisplay display = glfwGetEGLDisplay();
+        const char* exts = eglQueryString(display, EGL_EXTENSIONS);
+        m_native->eglDisplay = display;
+        m_native->eglSurface = glfwGetEGLSurface(window);
+        m_native->bufferAge = hasExtension(exts, "EGL_EXT_buffer_age");
+
+        /* The KHR and EXT entry points have the same signature */
+        if (hasExtension(exts, "EGL_KHR_swap_buffers_with_damage")) {
+            m_native->swapWithDamage =
+                (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress(
+                    "eglSwapBuffersWithDamageKHR");
+        } else if (hasExtension(exts, "EGL_EXT_swap_buffers_with_damage")) {
+            m_native->swapWithDamage =
+                (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress(
+                    "eglSwapBuffersWithDamageEXT");
+        }
+        /* Lets tiled GPUs skip loading undamaged parts of the buffer */
+        if (hasExtension(exts, "EGL_KHR_partial_update")) {
+            m_native->setDamageRegion =
+                (PFNEGLSETDAMAGEREGIONKHRPROC)eglGetProcAddress(
+                    "eglSetDamageRegionKHR");
+            m_native->bufferAge = true;
+        }
+        return;
+    }
+#endif
+#ifdef NNM_WITH_GLX
+    Display* display = glfwGetX11Display();
+    if (api == GLFW_NATIVE_CONTEXT_API && display) {
+        const char* exts =
+            glXQueryExtensionsString(display, DefaultScreen(display));
+        m_native->glxDisplay = display;
+        m_native->glxDrawable = glfwGetGLXWindow(window);
+        m_native->bufferAge = hasExtension(exts, "GLX_EXT_buffer_age");
+    }
+#endif
+}
+
+Presenter::~Presenter() = default;
+
+int
+Presenter::m_bufferAge()
+{
+    if (!m_native->bufferAge) {
+        return 0;
+    }
+#ifdef NNM_WITH_EGL
+    if (m_native->eglSurface != EGL_NO_SURFACE) {
+        EGLint age = 0;
+        eglQuerySurface(m_native->eglDisplay, m_native->eglSurface,
+                        EGL_BUFFER_AGE_EXT, &age);
+        return age;
+    }
+#endif
+#ifdef NNM_WITH_GLX
+    if (m_native->glxDisplay) {
+        unsigned int age = 0;
+        glXQueryDrawable(m_native->glxDisplay, m_native->glxDrawable,
+                         GLX_BACK_BUFFER_AGE_EXT, &age);
+        return age;
+    }
+#endif
+    return 0;
+}
+
+void
+Presenter::m_setDamageRegion(const Region* region)
+{
+#ifdef NNM_WITH_EGL
+    if (!m_native->setDamageRegion) {
+        return;
+    }
+    if (!region) {
+        EGLint all[] = {0, 0, m_width, m_height};
+        m_native->setDamageRegion(m_native->eglDisplay,
+                                  m_native->eglSurface, all, 1);
+        return;
+    }
+    std::vector<EGLint> rects;
+    rects.reserve(region->size() * 4);
+    for (const auto& rect : *region) {
+        rects.insert(rects.end(), {rect.x, rect.y, rect.width, rect.height});
+    }
+    m_native->setDamageRegion(m_native->eglDisplay, m_native->eglSurface,
+                              rects.data(), region->size());
+#else
+    (void)region;
+#endif
+}
+
+static CefRect
+boundsOf(const Presenter::Region& region)
+{
+    int x0 = region.front().x, y0 = region.front().y;
+    int x1 = x0, y1 = y0;
+    for (const auto& rect : region) {
+        x0 = std::min(x0, rect.x);
+        y0 = std::min(y0, rect.y);
+        x1 = std::max(x1, rect.x + rect.width);
+        y1 = std::max(y1, rect.y + rect.height);
+    }
+    return CefRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool
+Presenter::begin(int width, int height, const Region& damage,
+                 Region& redraw)
+{
+    if (width != m_width || height != m_height) {
+        /* Old buffers have the wrong size, their damage is meaningless */
+        m_width = width;
+        m_height = height;
+        m_history.clear();
+    }
+    m_damage = damage;
+
+    /* A buffer of age n missed the last n - 1 frames */
+    size_t age = m_bufferAge();
+    bool partial = age > 0 && age - 1 <= m_history.size();
+    if (partial) {
+        redraw = damage;
+        for (size_t i = 0; i + 1 < age; i++) {
+            redraw.insert(redraw.end(), m_history[i].begin(),
+                          m_history[i].end());
+        }
+        if (redraw.size() > MAX_RECTS) {
+            redraw.assign(1, boundsOf(redraw));
+        }
+
+        /* Past three quarters of the buffer, one draw beats many */
+        int64_t area = 0;
+        for (const auto& rect : redraw) {
+            area += int64_t(rect.width) * rect.height;
+        }
+        partial = area * 4 < int64_t(width) * height * 3;
+    }
+
+    m_setDamageRegion(partial ? &redraw : nullptr);
+    return partial;
+}
+
+void
+Presenter::present()
+{
+    bool swapped = false;
+#ifdef NNM_WITH_EGL
+    if (m_native->swapWithDamage) {
+        std::vector<EGLint> rects;
+        rects.reserve(m_damage.size() * 4);
+        for (const auto& rect : m_damage) {
+            rects.insert(rects.end(),
+                         {rect.x, rect.y, rect.width, rect.height});
+        }
+        swapped = m_native->swapWithDamage(m_native->eglDisplay,
+                                           m_native->eglSurface,
+                                           rects.data(), m_damage.size());
+    }
+#endif
+    if (!swapped) {
+        glfwSwapBuffers(m_window);
+    }
+
+    m_history.push_front(std::move(m_damage));
+    if (m_history.size() > MAX_AGE) {
+        m_history.pop_back();
+    }
+}
+
+} // namespace nanamo
@@ -0,0 +1,95 @@
+/** present.hh -- Damage-aware presentation definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_PRESENT_HH_
+#define NNM_PRESENT_HH_
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+namespace nanamo {
+
+/**
+ * Presents a window's frames, redrawing and swapping only what changed.
+ *
+ * Rects are in framebuffer pixels with GL's bottom-left origin. Where the
+ * back buffer's age is known (EGL_EXT_buffer_age, GLX_EXT_buffer_age), the
+ * damage of the frames it missed tells which parts of it are stale; without
+ * it every frame is a full redraw. Damage is passed on to the compositor
+ * with EGL_KHR_swap_buffers_with_damage or the EXT variant where available.
+ */
+class Presenter {
+  public:
+    typedef std::vector<CefRect> Region;
+
+  private:
+    /* Frames of damage kept, older back buffers are redrawn in full */
+    static constexpr size_t MAX_AGE = 4;
+    /* Beyond this many rects, redraw their bounding box */
+    static constexpr size_t MAX_RECTS = 16;
+
+    struct Native;
+
+    GLFWwindow* m_window;
+    std::unique_ptr<Native> m_native;
+
+    int m_width = 0;
+    int m_height = 0;
+    Region m_damage;
+    /* Damage of the last presented frames, newest first */
+    std::deque<Region> m_history;
+
+    int m_bufferAge();
+    /* Null for the whole buffer */
+    void m_setDamageRegion(const Region*);
+
+  public:
+    explicit Presenter(GLFWwindow*);
+    ~Presenter();
+
+    Presenter(const Presenter&) = delete;
+    Presenter& operator=(const Presenter&) = delete;
+
+    /**
+     * Start a width x height frame where damage changed, the window's
+     * context must be current. Returns false if the whole back buffer needs
+     * drawing, otherwise fills redraw with the parts that do.
+     */
+    bool begin(int width, int height, const Region& damage, Region& redraw);
+    /** Swap buffers, telling the compositor what begin() was given */
+    void present();
+};
+
+/** Whether the space separated extension list has name, false if null */
+bool hasExtension(const char* list, const char* name);
+
+} // namespace nanamo
+
+#endif /* NNM_PRESENT_HH_ */
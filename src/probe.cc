@@ -0,0 +1,162 @@
+/** probe.cc -- Input latency probe implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "probe.hh"
+
+namespace nanamo {
+
+LatencyProbe::LatencyProbe(int count) : m_count(count) {}
+
+void
+LatencyProbe::m_schedule(int64_t now)
+{
+    m_phase = Phase::Idle;
+    m_next = now + GAP + int64_t(m_random() % JITTER);
+}
+
+int64_t
+LatencyProbe::timeout(int64_t now) const
+{
+    std::unique_lock guard(m_lock);
+    if (!m_seen || m_samples + m_missed >= m_count) {
+        /* Waiting for the first paint, or finished */
+        return -1;
+    }
+    int64_t due = m_phase == Phase::Idle ? m_next : m_clicked + MAX_WAIT;
+    return std::max<int64_t>(due - now, 0);
+}
+
+bool
+LatencyProbe::clickDue(int64_t now)
+{
+    std::unique_lock guard(m_lock);
+    if (m_phase != Phase::Idle && now - m_clicked >= MAX_WAIT) {
+        m_missed++;
+        m_schedule(now);
+    }
+    return m_phase == Phase::Idle && m_seen && now >= m_next &&
+           m_samples + m_missed < m_count;
+}
+
+void
+LatencyProbe::clicked(int64_t now)
+{
+    std::unique_lock guard(m_lock);
+    m_phase = Phase::Clicked;
+    m_clicked = now;
+    m_expected = !m_shown;
+}
+
+void
+LatencyProbe::painted(const void* data, int width, int height)
+{
+    if (width <= PIXEL || height <= PIXEL) {
+        return;
+    }
+    /* BGRA, black or white */
+    auto pixel = static_cast<const uint8_t*>(data) +
+                 (size_t(PIXEL) * width + PIXEL) * 4;
+    bool shown = pixel[1] > 127;
+    int64_t now = Stats::now();
+
+    std::unique_lock guard(m_lock);
+    if (!m_seen) {
+        m_seen = true;
+        m_next = now + SETTLE;
+    }
+    m_shown = shown;
+    if (m_phase == Phase::Clicked && shown == m_expected) {
+        m_phase = Phase::Painted;
+        m_painted = now;
+    }
+}
+
+void
+LatencyProbe::uploaded()
+{
+    std::unique_lock guard(m_lock);
+    if (m_phase == Phase::Painted) {
+        m_phase = Phase::Uploaded;
+        m_uploaded = Stats::now();
+    }
+}
+
+void
+LatencyProbe::presented(int64_t now)
+{
+    std::unique_lock guard(m_lock);
+    if (m_phase != Phase::Uploaded) {
+        return;
+    }
+    m_toPaint.record(m_painted - m_clicked);
+    m_toUpload.record(m_uploaded - m_clicked);
+    m_toPresent.record(now - m_clicked);
+    if (Stats* stats = Stats::get()) {
+        stats->inputToPaint.record(m_painted - m_clicked);
+        stats->inputToUpload.record(m_uploaded - m_clicked);
+        stats->inputToPresent.record(now - m_clicked);
+    }
+    m_samples++;
+    m_schedule(now);
+}
+
+bool
+LatencyProbe::done() const
+{
+    std::unique_lock guard(m_lock);
+    return m_samples + m_missed >= m_count;
+}
+
+void
+LatencyProbe::report(std::ostream& os)
+{
+    struct Row {
+        const char* name;
+        Histogram& histogram;
+    };
+    const Row rows[] = {
+        {"input_to_paint", m_toPaint},
+        {"input_to_upload", m_toUpload},
+        {"input_to_present", m_toPresent},
+    };
+
+    std::unique_lock guard(m_lock);
+    auto flags = os.flags();
+    os << "[latency] " << m_samples << " clicks, " << m_missed << " missed"
+       << std::endl;
+    os << std::fixed << std::setprecision(3);
+    for (const auto& row : rows) {
+        auto summary = row.histogram.take();
+        os << "[latency]   " << std::left << std::setw(20) << row.name
+           << std::right << "n " << std::setw(6) << summary.count << "  p50 "
+           << summary.p50 / 1e6 << "ms  p99 " << summary.p99 / 1e6
+           << "ms  max " << summary.max / 1e6 << "ms" << std::endl;
+    }
+    os.flags(flags);
+}
+
+} // namespace nanamo
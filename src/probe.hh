@@ -0,0 +1,119 @@
+/** probe.hh -- Input latency probe definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_PROBE_HH_
+#define NNM_PROBE_HH_
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <random>
+
+#include "stats.hh"
+
+namespace nanamo {
+
+/**
+ * Measures input latency, see --latency-probe.
+ *
+ * The overlay loads PAGE_URL, a page whose top-left square flips between
+ * black and white on every mouse press, and clicks it through its usual
+ * input path whenever clickDue(). The probe then watches paints for the
+ * square to flip, and times the paint, its upload and the present that
+ * shows it from the click. Clicks are spaced by a gap with some jitter, so
+ * they land at every point of the display's refresh cycle.
+ */
+class LatencyProbe {
+  public:
+    static constexpr const char* PAGE_URL =
+        "data:text/html,<style>body{margin:0;background:black}"
+        "div{width:64px;height:64px;background:black}"
+        ".on div{background:white}</style><div></div>"
+        "<script>onmousedown=()=>document.body.classList.toggle('on')"
+        "</script>";
+    /* Where to click, in window coordinates */
+    static constexpr double CLICK_X = 16;
+    static constexpr double CLICK_Y = 16;
+
+  private:
+    /* Buffer pixel that shows the square, at any sensible render scale */
+    static constexpr int PIXEL = 4;
+    /* Time for the page to settle after its first paint */
+    static constexpr int64_t SETTLE = 1'000'000'000;
+    /* Between a present and the next click, plus up to a 60 Hz frame */
+    static constexpr int64_t GAP = 100'000'000;
+    static constexpr int64_t JITTER = 16'666'667;
+    /* Clicks that show nothing for this long are counted as missed */
+    static constexpr int64_t MAX_WAIT = 1'000'000'000;
+
+    enum class Phase { Idle, Clicked, Painted, Uploaded };
+
+    /* Paints may arrive on CEF's thread */
+    mutable std::mutex m_lock;
+    Phase m_phase = Phase::Idle;
+    bool m_seen = false;
+    bool m_shown = false;
+    bool m_expected = false;
+    int64_t m_next = 0;
+    int64_t m_clicked = 0;
+    int64_t m_painted = 0;
+    int64_t m_uploaded = 0;
+
+    int m_count;
+    int m_samples = 0;
+    int m_missed = 0;
+    std::minstd_rand m_random;
+
+    Histogram m_toPaint;
+    Histogram m_toUpload;
+    Histogram m_toPresent;
+
+    void m_schedule(int64_t now);
+
+  public:
+    /** Take count samples, clicks that are missed count as well */
+    explicit LatencyProbe(int count);
+
+    /** Nanoseconds until the next click is due, negative if never */
+    int64_t timeout(int64_t now) const;
+    bool clickDue(int64_t now);
+    /** The click was queued, the square should flip */
+    void clicked(int64_t now);
+
+    /** A paint of the view arrived, before anything else happened to it */
+    void painted(const void* data, int width, int height);
+    /** The latest paint was uploaded to the view texture */
+    void uploaded();
+    /** A frame was presented, showing everything uploaded */
+    void presented(int64_t now);
+
+    /** Whether every sample was taken */
+    bool done() const;
+    /** Print the latency distribution */
+    void report(std::ostream&);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_PROBE_HH_ */
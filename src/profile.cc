@@ -0,0 +1,103 @@
+/** profile.cc -- Performance profile implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+
+#include "profile.hh"
+
+namespace nanamo {
+
+struct Switch {
+    const char* name;
+    const char* value;
+};
+
+static const Switch leanSwitches[] = {
+    {"disable-gpu", nullptr},
+    {"disable-gpu-compositing", nullptr},
+    {"renderer-process-limit", "1"},
+    {"js-flags", "--max-old-space-size=128"},
+    {"disk-cache-size", "16777216"},
+    {"disable-extensions", nullptr},
+    {"disable-component-update", nullptr},
+    {nullptr, nullptr},
+};
+
+static const Switch balancedSwitches[] = {
+    {"disable-gpu-compositing", nullptr},
+    {"renderer-process-limit", "4"},
+    {"disk-cache-size", "67108864"},
+    {"disable-component-update", nullptr},
+    {nullptr, nullptr},
+};
+
+static const Switch qualitySwitches[] = {
+    {"enable-gpu-rasterization", nullptr},
+    {"ignore-gpu-blocklist", nullptr},
+    {"disable-background-timer-throttling", nullptr},
+    {"disable-renderer-backgrounding", nullptr},
+    {nullptr, nullptr},
+};
+
+bool
+parseProfile(const char* str, Profile& profile)
+{
+    if (std::strcmp(str, "lean") == 0) {
+        profile = Profile::LEAN;
+    } else if (std::strcmp(str, "balanced") == 0) {
+        profile = Profile::BALANCED;
+    } else if (std::strcmp(str, "quality") == 0) {
+        profile = Profile::QUALITY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void
+applyProfile(Profile profile, CefRefPtr<CefCommandLine> commandLine)
+{
+    const Switch* switches = nullptr;
+    switch (profile) {
+    case Profile::LEAN:
+        switches = leanSwitches;
+        break;
+    case Profile::BALANCED:
+        switches = balancedSwitches;
+        break;
+    case Profile::QUALITY:
+        switches = qualitySwitches;
+        break;
+    }
+
+    for (const Switch* s = switches; s->name; s++) {
+        if (s->value) {
+            commandLine->AppendSwitchWithValue(s->name, s->value);
+        } else {
+            commandLine->AppendSwitch(s->name);
+        }
+    }
+}
+
+} // namespace nanamo
@@ -0,0 +1,54 @@
+/** profile.hh -- Performance profile definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_PROFILE_HH_
+#define NNM_PROFILE_HH_
+
+#include <cef_command_line.h>
+
+namespace nanamo {
+
+/**
+ * Sets of Chromium switches trading memory for rendering quality.
+ *
+ * Lean runs without a GPU process, in a single renderer with a capped V8
+ * heap. Balanced keeps the GPU for pages but composites in software, which
+ * off-screen rendering reads back anyway. Quality rasterizes on the GPU and
+ * keeps timers running at full rate.
+ */
+enum class Profile {
+    LEAN,
+    BALANCED,
+    QUALITY,
+};
+
+/** Parse lean, balanced or quality */
+bool parseProfile(const char* str, Profile& profile);
+
+/** Add the profile's switches to the browser process' command line */
+void applyProfile(Profile, CefRefPtr<CefCommandLine>);
+
+} // namespace nanamo
+
+#endif /* NNM_PROFILE_HH_ */
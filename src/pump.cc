@@ -0,0 +1,124 @@
+/** pump.cc -- CEF message pump implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include <cef_app.h>
+
+#include <GLFW/glfw3.h>
+
+#include "pump.hh"
+#include "trace.hh"
+
+namespace nanamo {
+
+int64_t
+MessagePump::m_now()
+{
+    using namespace std::chrono;
+    auto now = steady_clock::now().time_since_epoch();
+    return duration_cast<milliseconds>(now).count();
+}
+
+void
+MessagePump::schedule(int64_t delayMs)
+{
+    m_due = m_now() + std::max<int64_t>(delayMs, 0);
+    wake();
+}
+
+void
+MessagePump::wake()
+{
+    std::unique_lock guard(m_wakeLock);
+    if (m_wakeable) {
+        glfwPostEmptyEvent();
+    }
+    m_woken = true;
+    m_wakeCond.notify_one();
+}
+
+void
+MessagePump::setMultiThreaded()
+{
+    m_multiThreaded = true;
+}
+
+void
+MessagePump::attach()
+{
+    std::unique_lock guard(m_wakeLock);
+    m_wakeable = true;
+}
+
+void
+MessagePump::detach()
+{
+    std::unique_lock guard(m_wakeLock);
+    m_wakeable = false;
+}
+
+void
+MessagePump::wait(double timeout)
+{
+    std::unique_lock guard(m_wakeLock);
+    m_wakeCond.wait_for(guard, std::chrono::duration<double>(timeout),
+                        [this] { return m_woken; });
+    m_woken = false;
+}
+
+int64_t
+MessagePump::m_deadline() const
+{
+    return std::min<int64_t>(m_due, m_lastWork + MAX_DELAY_MS);
+}
+
+double
+MessagePump::timeout() const
+{
+    if (m_multiThreaded) {
+        return MAX_DELAY_MS / 1000.0;
+    }
+    int64_t delay = std::max<int64_t>(m_deadline() - m_now(), 0);
+    return delay / 1000.0;
+}
+
+bool
+MessagePump::due() const
+{
+    return !m_multiThreaded && m_deadline() <= m_now();
+}
+
+void
+MessagePump::doWork()
+{
+    /* Cleared first: CEF may schedule more work from inside the call */
+    m_due = NOT_SCHEDULED;
+    m_lastWork = m_now();
+    TraceSpan span("CefDoMessageLoopWork");
+    CefDoMessageLoopWork();
+}
+
+} // namespace nanamo
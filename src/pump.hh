@@ -0,0 +1,86 @@
+/** pump.hh -- CEF message pump definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_PUMP_HH_
+#define NNM_PUMP_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace nanamo {
+
+/**
+ * Schedules CefDoMessageLoopWork calls for the external message pump.
+ *
+ * CEF asks for work from arbitrary threads through schedule(); the main loop
+ * sleeps in glfwWaitEventsTimeout(), or wait() without a window, for
+ * timeout() seconds and calls doWork() once the work is due.
+ */
+class MessagePump {
+  private:
+    /* Longest we sleep without CEF asking, in case a request is missed */
+    static constexpr int64_t MAX_DELAY_MS = 1000 / 30;
+    static constexpr int64_t NOT_SCHEDULED = INT64_MAX;
+
+    std::atomic<int64_t> m_due = NOT_SCHEDULED;
+    int64_t m_lastWork = 0;
+
+    std::mutex m_wakeLock;
+    std::condition_variable m_wakeCond;
+    bool m_wakeable = false;
+    bool m_woken = false;
+    bool m_multiThreaded = false;
+
+    static int64_t m_now();
+    int64_t m_deadline() const;
+
+  public:
+    /** Request work after delayMs, replacing any pending request */
+    void schedule(int64_t delayMs);
+    /** Interrupt the loop's wait without requesting work */
+    void wake();
+    /**
+     * CEF runs its own message loop thread, so work is never due; the
+     * loop still wakes at least every MAX_DELAY_MS
+     */
+    void setMultiThreaded();
+
+    /** Start waking GLFW's event wait, GLFW must be initialized */
+    void attach();
+    /** Stop waking GLFW, call before glfwTerminate() */
+    void detach();
+    /** Sleep up to timeout seconds, or until work is scheduled */
+    void wait(double timeout);
+
+    /** Seconds until pending work is due */
+    double timeout() const;
+    bool due() const;
+    void doWork();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_PUMP_HH_ */
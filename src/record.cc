@@ -0,0 +1,128 @@
+/** record.cc -- Frame recording implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "record.hh"
+#include "stats.hh"
+
+namespace nanamo {
+
+FrameRecorder::FrameRecorder(const std::string& path)
+{
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        throw std::runtime_error(path + ": " + std::strerror(errno));
+    }
+    /* Paints arrive as many small writes */
+    m_buffer.resize(1 << 20);
+    std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+
+    RecordHeader header = {};
+    std::memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    m_write(&header, sizeof(header));
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    if (std::fclose(m_file) != 0 && !m_failed) {
+        std::cerr << "Failed to finish recording: " << std::strerror(errno)
+                  << std::endl;
+    }
+}
+
+void
+FrameRecorder::m_write(const void* data, size_t size)
+{
+    if (m_failed || std::fwrite(data, 1, size, m_file) == size) {
+        return;
+    }
+    /* Can't throw through CEF, give up on the rest of the recording */
+    std::cerr << "Recording stopped: " << std::strerror(errno) << std::endl;
+    m_failed = true;
+}
+
+void
+FrameRecorder::record(const CefRenderHandler::RectList& dirtyRects,
+                      const void* data, int width, int height)
+{
+    if (m_failed) {
+        return;
+    }
+
+    int64_t now = Stats::now();
+    if (!m_start) {
+        m_start = now;
+    }
+
+    bool keyframe = width != m_width || height != m_height ||
+                    now - m_lastKeyframe >= KEYFRAME_INTERVAL;
+    m_rects.clear();
+    if (keyframe) {
+        m_rects.push_back({0, 0, width, height});
+        m_width = width;
+        m_height = height;
+        m_lastKeyframe = now;
+    } else {
+        for (const auto& rect : dirtyRects) {
+            int x0 = std::max(rect.x, 0);
+            int y0 = std::max(rect.y, 0);
+            int x1 = std::min(rect.x + rect.width, width);
+            int y1 = std::min(rect.y + rect.height, height);
+            if (x0 < x1 && y0 < y1) {
+                m_rects.push_back({x0, y0, x1 - x0, y1 - y0});
+            }
+        }
+    }
+
+    RecordFrame frame = {
+        .type = keyframe ? RECORD_KEYFRAME : RECORD_DELTA,
+        .rectCount = uint32_t(m_rects.size()),
+        .width = uint32_t(width),
+        .height = uint32_t(height),
+        .time = now - m_start,
+    };
+    m_write(&frame, sizeof(frame));
+    m_write(m_rects.data(), m_rects.size() * sizeof(RecordRect));
+
+    auto pixels = static_cast<const uint8_t*>(data);
+    size_t stride = size_t(width) * 4;
+    for (const auto& rect : m_rects) {
+        const uint8_t* row = pixels + rect.y * stride + size_t(rect.x) * 4;
+        if (rect.width == width) {
+            m_write(row, rect.height * stride);
+            continue;
+        }
+        for (int y = 0; y < rect.height; y++, row += stride) {
+            m_write(row, size_t(rect.width) * 4);
+        }
+    }
+}
+
+} // namespace nanamo
@@ -0,0 +1,75 @@
+/** record.hh -- Frame recording definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_RECORD_HH_
+#define NNM_RECORD_HH_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+#include "recordfmt.hh"
+
+namespace nanamo {
+
+/**
+ * Writes every paint to a file, see recordfmt.hh.
+ *
+ * Only dirty rects are stored, with a keyframe on the first paint, on size
+ * changes and every KEYFRAME_INTERVAL so replay can start anywhere near.
+ */
+class FrameRecorder {
+  private:
+    static constexpr int64_t KEYFRAME_INTERVAL = 2'000'000'000;
+
+    std::FILE* m_file;
+    std::vector<char> m_buffer;
+    bool m_failed = false;
+
+    int64_t m_start = 0;
+    int64_t m_lastKeyframe = 0;
+    int m_width = 0;
+    int m_height = 0;
+
+    std::vector<RecordRect> m_rects;
+
+    void m_write(const void* data, size_t size);
+
+  public:
+    explicit FrameRecorder(const std::string& path);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    void record(const CefRenderHandler::RectList& dirtyRects,
+                const void* data, int width, int height);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_RECORD_HH_ */
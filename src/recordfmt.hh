@@ -0,0 +1,74 @@
+/** recordfmt.hh -- Frame recording file format definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_RECORDFMT_HH_
+#define NNM_RECORDFMT_HH_
+
+#include <cstdint>
+
+/*
+ * A recording is a RecordHeader followed by one record per paint, in host
+ * byte order. Each record is a RecordFrame, rectCount RecordRects, then the
+ * pixels of each rect in turn: premultiplied BGRA, rows packed at
+ * rect width * 4 bytes. Keyframes hold a single rect covering the whole
+ * frame; deltas only the areas that changed since the previous record.
+ */
+
+namespace nanamo {
+
+static constexpr char RECORD_MAGIC[4] = {'N', 'N', 'M', 'R'};
+static constexpr uint32_t RECORD_VERSION = 1;
+/* Limits readers may hold records to, no paint comes near them */
+static constexpr uint32_t RECORD_MAX_SIZE = 16384;
+static constexpr uint32_t RECORD_MAX_RECTS = 65536;
+
+struct RecordHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+enum RecordType : uint32_t {
+    RECORD_KEYFRAME = 1,
+    RECORD_DELTA = 2,
+};
+
+struct RecordFrame {
+    uint32_t type;
+    uint32_t rectCount;
+    uint32_t width;
+    uint32_t height;
+    /* Nanoseconds since the first record */
+    int64_t time;
+};
+
+struct RecordRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+} // namespace nanamo
+
+#endif /* NNM_RECORDFMT_HH_ */
@@ -22,6 +22,8 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <mutex>
 #include <stdexcept>
@@ -35,6 +37,29 @@
 
 namespace nanamo {
 
+bool
+parseGeometry(const char* str, Geometry& geometry)
+{
+    int len = 0;
+    if (std::sscanf(str, "%dx%d%n", &geometry.width, &geometry.height,
+                    &len) != 2) {
+        return false;
+    }
+    if (geometry.width <= 0 || geometry.height <= 0) {
+        return false;
+    }
+
+    str += len;
+    if (*str == '\0') {
+        return true;
+    }
+    if (std::sscanf(str, "%d%d%n", &geometry.x, &geometry.y, &len) != 2) {
+        return false;
+    }
+    geometry.positioned = true;
+    return str[len] == '\0';
+}
+
 static void
 errorCallback(int errcode, const char* desc)
 {
@@ -44,29 +69,123 @@ errorCallback(int errcode, const char* desc)
     std::cerr << "GLFW error " << errcode << ": " << desc << std::endl;
 }
 
-Renderer::Renderer(const RendererOptions& opts)
+RenderContext::RenderContext(ContextApi api) : m_api(api)
 {
+    if (api == ContextApi::SURFACELESS) {
+        m_surfaceless = std::make_unique<SurfacelessContext>();
+        glewExperimental = true;
+        if (glewContextInit() != GLEW_OK) {
+            throw std::runtime_error("GLEW initialization failed");
+        }
+        m_createProgram();
+        m_initBuffers();
+        return;
+    }
+
     if (!glfwInit()) {
         std::cerr << "GLFW initialization failed" << std::endl;
         std::abort();
     }
     glfwSetErrorCallback(&errorCallback);
 
-    m_createWindow(opts);
+    m_createWindow();
     m_createProgram();
     m_initBuffers();
-    m_initTexture();
-    m_spawnBrowser(opts);
 }
 
-Renderer::~Renderer()
+RenderContext::~RenderContext()
 {
+    makeCurrent();
     glDeleteBuffers(1, &m_vertexBuffer);
-    glDeleteVertexArrays(1, &m_vertexArray);
+    glDeleteBuffers(1, &m_uvBuffer);
     glDeleteProgram(m_program);
 
+    if (m_window) {
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
+}
+
+void
+RenderContext::contextHints() const
+{
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (m_api == ContextApi::EGL) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
+}
+
+void
+RenderContext::m_createWindow()
+{
+    contextHints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    m_window = glfwCreateWindow(1, 1, "Nanamo", nullptr, nullptr);
+    if (!m_window) {
+        throw std::runtime_error("failed to create GLFW window");
+    }
+    glfwDefaultWindowHints();
+
+    glfwMakeContextCurrent(m_window);
+    glewExperimental = true;
+    /* glewInit() also loads GLX entry points, and fails without a GLX
+     * context */
+    bool egl = m_api == ContextApi::EGL;
+    if ((egl ? glewContextInit() : glewInit()) != GLEW_OK) {
+        throw std::runtime_error("GLEW initialization failed");
+    }
+}
+
+void
+RenderContext::makeCurrent()
+{
+    if (m_surfaceless) {
+        m_surfaceless->makeCurrent();
+        return;
+    }
+    glfwMakeContextCurrent(m_window);
+}
+
+GLFWwindow*
+RenderContext::window() const
+{
+    return m_window;
+}
+
+Renderer::Renderer(const RendererOptions& opts, RenderContext& context)
+    : m_context(context), m_url(opts.url), m_governor(opts.frameRate)
+{
+    StartupReport* startup = StartupReport::get();
+    m_startup = startup ? startup->addOverlay(opts.url) : nullptr;
+
+    /* The browser is created while the window is set up */
+    m_spawnBrowser(opts);
+    try {
+        m_createWindow(opts);
+        m_compositor.emplace(m_context, *m_surface, m_renderHandler,
+                             opts.sharpness);
+    } catch (...) {
+        m_browserClient->close();
+        throw;
+    }
+    if (m_startup) {
+        m_startup->mark(StartupReport::WINDOW);
+    }
+}
+
+Renderer::~Renderer()
+{
+    m_browserClient->close();
+
+    m_context.makeCurrent();
+    m_renderHandler->close();
+
+    m_compositor.reset();
+    m_surface.reset();
     glfwDestroyWindow(m_window);
-    glfwTerminate();
 }
 
 static auto
@@ -82,6 +201,34 @@ windowResizeCallback(GLFWwindow* window, int width, int height)
     rendererPtr->onResize(width, height);
 }
 
+static void
+windowRefreshCallback(GLFWwindow* window)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onRefresh();
+}
+
+static void
+windowPosCallback(GLFWwindow* window, int, int)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onMove();
+}
+
+static void
+windowFocusCallback(GLFWwindow* window, int focused)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onFocus(focused == GLFW_TRUE);
+}
+
+static void
+windowIconifyCallback(GLFWwindow* window, int iconified)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onIconify(iconified == GLFW_TRUE);
+}
+
 static void
 mouseMoveCallback(GLFWwindow* window, double x, double y)
 {
@@ -90,37 +237,111 @@ mouseMoveCallback(GLFWwindow* window, double x, double y)
 }
 
 static void
-mouseClickCallback(GLFWwindow* window, int button, int action, int)
+mouseEnterCallback(GLFWwindow* window, int entered)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onMouseEnter(entered == GLFW_TRUE);
+}
+
+static void
+mouseClickCallback(GLFWwindow* window, int button, int action, int mods)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onMouseClick(button, action, mods);
+}
+
+static void
+scrollCallback(GLFWwindow* window, double dx, double dy)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onScroll(dx, dy);
+}
+
+static void
+keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
     auto rendererPtr = getRendererPtr(window);
-    rendererPtr->onMouseClick(button, action);
+    rendererPtr->onKey(key, scancode, action, mods);
+}
+
+static void
+charCallback(GLFWwindow* window, unsigned int codepoint)
+{
+    auto rendererPtr = getRendererPtr(window);
+    rendererPtr->onChar(codepoint);
+}
+
+static int
+refreshRateOf(GLFWwindow* window)
+{
+    /* Use the monitor under the window's center, or the primary one where
+     * window positions are unknown. */
+    int x, y, width, height;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    int cx = x + width / 2;
+    int cy = y + height / 2;
+
+    int count = 0;
+    GLFWmonitor** monitors = glfwGetMonitors(&count);
+    for (int i = 0; i < count; i++) {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+        int mx, my;
+        glfwGetMonitorPos(monitors[i], &mx, &my);
+        if (mode && cx >= mx && cx < mx + mode->width && cy >= my &&
+            cy < my + mode->height) {
+            return mode->refreshRate;
+        }
+    }
+
+    GLFWmonitor* primary = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = primary ? glfwGetVideoMode(primary) : nullptr;
+    return mode ? mode->refreshRate : 0;
 }
 
 void
 Renderer::m_createWindow(const RendererOptions& opts)
 {
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    m_context.contextHints();
     glfwWindowHint(GLFW_DECORATED, opts.border ? GLFW_TRUE : GLFW_FALSE);
     glfwWindowHint(GLFW_RESIZABLE, opts.resizable ? GLFW_TRUE : GLFW_FALSE);
     glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER,
                    opts.transparent ? GLFW_TRUE : GLFW_FALSE);
 
-    m_window = glfwCreateWindow(640, 480, "Nanamo", nullptr, nullptr);
+    m_window = glfwCreateWindow(opts.width, opts.height, "Nanamo", nullptr,
+                                m_context.window());
     if (!m_window) {
         throw std::runtime_error("failed to create GLFW window");
     }
+    glfwDefaultWindowHints();
+    if (opts.positioned) {
+        glfwSetWindowPos(m_window, opts.x, opts.y);
+    }
+
     glfwSetWindowUserPointer(m_window, this);
     glfwSetWindowSizeCallback(m_window, windowResizeCallback);
+    glfwSetWindowRefreshCallback(m_window, windowRefreshCallback);
+    glfwSetWindowPosCallback(m_window, windowPosCallback);
+    glfwSetWindowFocusCallback(m_window, windowFocusCallback);
+    glfwSetWindowIconifyCallback(m_window, windowIconifyCallback);
     glfwSetCursorPosCallback(m_window, mouseMoveCallback);
+    glfwSetCursorEnterCallback(m_window, mouseEnterCallback);
     glfwSetMouseButtonCallback(m_window, mouseClickCallback);
+    glfwSetScrollCallback(m_window, scrollCallback);
+    glfwSetKeyCallback(m_window, keyCallback);
+    glfwSetCharCallback(m_window, charCallback);
+    /* Report caps and num lock state along with the other modifiers */
+    glfwSetInputMode(m_window, GLFW_LOCK_KEY_MODS, GLFW_TRUE);
+
+    m_updateRefreshRate();
+    m_focused = glfwGetWindowAttrib(m_window, GLFW_FOCUSED);
+    m_governor.onFocus(m_focused);
 
     glfwMakeContextCurrent(m_window);
-    glewExperimental = true;
-    if (glewInit() != GLEW_OK) {
-        throw std::runtime_error("GLEW initialization failed");
+    if (opts.swapInterval >= 0) {
+        glfwSwapInterval(opts.swapInterval);
     }
+    m_surface.emplace(m_window);
 }
 
 static void
@@ -159,7 +380,7 @@ class ShaderDeleter {
 };
 
 void
-Renderer::m_createProgram()
+RenderContext::m_createProgram()
 {
     static const char* vertShaderCode =
         "#version 450 core\n"
@@ -175,8 +396,31 @@ Renderer::m_createProgram()
         "in vec2 UV;\n"
         "out vec4 color;\n"
         "uniform sampler2D tex;\n"
+        "uniform vec2 frameSize;\n"
+        "uniform float sharpness;\n"
+        /* The frame fills the top-left of a possibly larger texture, keep
+         * filtering from reaching past its edge */
+        "vec4 fetch(vec2 uv, vec2 limit) {\n"
+        "return texture(tex, min(uv, limit));\n"
+        "}\n"
         "void main(){\n"
-        "color = texture(tex, UV);\n"
+        "vec2 texSize = vec2(textureSize(tex, 0));\n"
+        "vec2 limit = (frameSize - 0.5) / texSize;\n"
+        "vec2 uv = UV * frameSize / texSize;\n"
+        "vec4 c = fetch(uv, limit);\n"
+        "if (sharpness > 0.0) {\n"
+        /* Unsharp mask over the four neighbouring texels */
+        "vec2 d = 1.0 / texSize;\n"
+        "vec4 n = fetch(uv + vec2(d.x, 0.0), limit)\n"
+        "       + fetch(uv - vec2(d.x, 0.0), limit)\n"
+        "       + fetch(uv + vec2(0.0, d.y), limit)\n"
+        "       + fetch(uv - vec2(0.0, d.y), limit);\n"
+        "vec4 s = c + sharpness * (c - 0.25 * n);\n"
+        /* Keep premultiplied color within alpha */
+        "s.a = clamp(s.a, 0.0, 1.0);\n"
+        "c = vec4(clamp(s.rgb, vec3(0.0), vec3(s.a)), s.a);\n"
+        "}\n"
+        "color = c;\n"
         "}";
 
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -213,15 +457,14 @@ Renderer::m_createProgram()
 
     m_posLocation = glGetAttribLocation(m_program, "pos");
     m_uvLocation = glGetAttribLocation(m_program, "uv");
-    m_texLocation = glGetAttribLocation(m_program, "tex");
+    m_texLocation = glGetUniformLocation(m_program, "tex");
+    m_frameSizeLocation = glGetUniformLocation(m_program, "frameSize");
+    m_sharpnessLocation = glGetUniformLocation(m_program, "sharpness");
 }
 
 void
-Renderer::m_initBuffers()
+RenderContext::m_initBuffers()
 {
-    glGenVertexArrays(1, &m_vertexArray);
-    glBindVertexArray(m_vertexArray);
-
     static GLfloat vertexBufferData[] = {
         /* clang-format off */
 	-1.0f, -1.0f,
@@ -257,37 +500,73 @@ Renderer::m_initBuffers()
                  GL_STATIC_DRAW);
 }
 
-void
-Renderer::m_initTexture()
-{
-    glGenTextures(1, &m_texture);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-}
-
 void
 Renderer::m_spawnBrowser(const RendererOptions& opts)
 {
     CefBrowserSettings browserSettings;
-    browserSettings.windowless_frame_rate = 60;
+    browserSettings.windowless_frame_rate = m_governor.initialFps();
 
     CefWindowInfo windowInfo;
     windowInfo.SetAsWindowless(0);
+    if (opts.beginFrames) {
+        windowInfo.external_begin_frame_enabled = true;
+        m_pacer.emplace();
+    }
 
-    m_renderHandler = new BrowserRenderHandler(640, 480);
-    m_browserClient = new BrowserClient(m_renderHandler);
-    m_browser =
-        CefBrowserHost::CreateBrowserSync(windowInfo, m_browserClient, opts.url,
-                                          browserSettings, nullptr, nullptr);
-    if (!m_browser) {
+    m_renderHandler =
+        new BrowserRenderHandler(opts.width, opts.height, opts.renderScale);
+    if (opts.shrinkDamage) {
+        m_renderHandler->enableDamageShrinking();
+    }
+    if (opts.clickThrough) {
+        m_renderHandler->enableHitMask(opts.hitAlpha);
+    }
+    if (!opts.exportPath.empty()) {
+        m_renderHandler->enableExport(opts.exportPath);
+    }
+    if (!opts.recordPath.empty()) {
+        m_renderHandler->enableRecording(opts.recordPath);
+    }
+    if (opts.threaded) {
+        m_renderHandler->enableMailbox([] { glfwPostEmptyEvent(); });
+    }
+    if (opts.latencyProbe > 0) {
+        m_probe.emplace(opts.latencyProbe);
+        m_renderHandler->enableLatencyProbe(*m_probe);
+    }
+    if (!opts.ingestPath.empty()) {
+        m_ingest = std::make_unique<IngestServer>(
+            opts.ingestPath, [] { glfwPostEmptyEvent(); });
+    }
+    if (m_startup) {
+        StartupReport::Overlay* startup = m_startup;
+        m_renderHandler->onFirstPaint(
+            [startup] { startup->mark(StartupReport::FIRST_PAINT); });
+    }
+    m_browserClient =
+        new BrowserClient(m_renderHandler, [] { glfwPostEmptyEvent(); });
+    /* Arrives in m_adoptBrowser() */
+    if (!m_browserClient->create(windowInfo, opts.url, browserSettings)) {
         throw std::runtime_error("Failed to create browser");
     }
 }
 
 void
-Renderer::m_render()
+Renderer::m_adoptBrowser()
+{
+    if (m_browser || !(m_browser = m_browserClient->takeBrowser())) {
+        return;
+    }
+    m_governor.setBrowser(m_browser);
+    m_browser->GetHost()->SetFocus(m_focused);
+    if (m_startup) {
+        m_startup->mark(StartupReport::BROWSER);
+    }
+}
+
+void
+RenderContext::drawQuad(GLuint texture, int width, int height,
+                        float sharpness)
 {
     glUseProgram(m_program);
 
@@ -295,8 +574,10 @@ Renderer::m_render()
     glEnableVertexAttribArray(m_uvLocation);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
     glUniform1i(m_texLocation, 0);
+    glUniform2f(m_frameSizeLocation, width, height);
+    glUniform1f(m_sharpnessLocation, sharpness);
 
     glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
     glVertexAttribPointer(m_posLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -311,54 +592,292 @@ Renderer::m_render()
 }
 
 void
-Renderer::onResize(int width, int height)
+Renderer::m_updateRefreshRate()
+{
+    int rate = refreshRateOf(m_window);
+    m_governor.setRefreshRate(rate);
+    /* Forward pointer motion and ingested data at most once per display
+     * refresh */
+    int64_t interval = int64_t(1e9) / (rate > 0 ? rate : 60);
+    m_input.setInterval(interval);
+    if (m_ingest) {
+        m_ingest->setInterval(interval);
+    }
+}
+
+void
+Renderer::m_updateInputRegion()
+{
+    HitMask* mask = m_renderHandler->hitMask();
+    if (!mask || !m_inputRegionSupported || !mask->takeChanged()) {
+        return;
+    }
+
+    int width, height;
+    glfwGetWindowSize(m_window, &width, &height);
+    mask->region(m_inputRegion);
+    double scaleX = double(width) / mask->width();
+    double scaleY = double(height) / mask->height();
+    if (!setInputRegion(m_window, m_inputRegion, scaleX, scaleY)) {
+        std::cerr << "Click-through is not supported on this platform"
+                  << std::endl;
+        m_inputRegionSupported = false;
+    }
+}
+
+int64_t
+Renderer::m_resizeDue() const
 {
-    glViewport(0, 0, width, height);
+    /* Once the size settles, and every so often while it keeps changing */
+    return std::min(m_lastResize + RESIZE_SETTLE_NS,
+                    m_lastResizeSent + RESIZE_INTERVAL_NS);
+}
 
-    m_renderHandler->resize(width, height);
+void
+Renderer::m_flushResize()
+{
+    int64_t now = Stats::now();
+    if (!m_browser || !m_resizePending || now < m_resizeDue()) {
+        return;
+    }
+    m_renderHandler->resize(m_resizeWidth, m_resizeHeight);
     m_browser->GetHost()->WasResized();
+    m_resizePending = false;
+    m_lastResizeSent = now;
+}
+
+void
+Renderer::onResize(int width, int height)
+{
+    /* Relayout and repaint at every step of a drag would fall behind, the
+     * last frame is stretched until the browser catches up */
+    m_resizeWidth = width;
+    m_resizeHeight = height;
+    m_resizePending = true;
+    m_lastResize = Stats::now();
+    m_compositor->invalidate();
+}
+
+void
+Renderer::onRefresh()
+{
+    m_compositor->invalidate();
+}
+
+void
+Renderer::onMove()
+{
+    m_updateRefreshRate();
+}
+
+void
+Renderer::onFocus(bool focused)
+{
+    m_governor.onFocus(focused);
+    m_focused = focused;
+    if (m_browser) {
+        m_browser->GetHost()->SetFocus(focused);
+    }
+}
+
+void
+Renderer::onIconify(bool iconified)
+{
+    m_governor.onIconify(iconified);
+    if (!iconified) {
+        m_compositor->invalidate();
+    }
 }
 
 void
 Renderer::onMouseMove(double x, double y)
 {
-    m_mouseX = x;
-    m_mouseY = y;
+    /* The view rect is in window coordinates whatever the render scale, so
+     * cursor positions need no mapping */
+    m_input.move(x, y);
+}
+
+void
+Renderer::onMouseEnter(bool entered)
+{
+    if (!entered) {
+        m_input.leave();
+    }
+}
+
+void
+Renderer::onMouseClick(int button, int action, int mods)
+{
+    m_input.button(button, action, mods);
+}
+
+void
+Renderer::onScroll(double dx, double dy)
+{
+    m_input.scroll(dx, dy);
+}
+
+void
+Renderer::onKey(int key, int scancode, int action, int mods)
+{
+    m_input.key(key, scancode, action, mods);
+}
+
+void
+Renderer::onChar(unsigned int codepoint)
+{
+    m_input.character(codepoint);
+}
+
+bool
+Renderer::shouldClose() const
+{
+    return glfwWindowShouldClose(m_window);
+}
+
+bool
+Renderer::frameReady() const
+{
+    return m_renderHandler->frameReady();
+}
+
+void
+Renderer::takeFrame()
+{
+    m_renderHandler->takeFrame();
+}
+
+void
+Renderer::reload()
+{
+    if (m_browser) {
+        m_browser->Reload();
+    }
+}
 
-    CefMouseEvent ev;
-    ev.x = m_mouseX;
-    ev.y = m_mouseY;
-    m_browser->GetHost()->SendMouseMoveEvent(ev, false);
+void
+Renderer::move(int x, int y)
+{
+    glfwSetWindowPos(m_window, x, y);
 }
 
 void
-Renderer::onMouseClick(int button, int action)
+Renderer::resize(int width, int height)
 {
-    CefMouseEvent ev;
-    ev.x = m_mouseX;
-    ev.y = m_mouseY;
+    /* The browser follows through the size callback */
+    glfwSetWindowSize(m_window, width, height);
+}
 
-    if (button == GLFW_MOUSE_BUTTON_LEFT) {
-        if (action == GLFW_PRESS) {
-	    m_browser->GetHost()->SendMouseClickEvent(ev, MBT_LEFT, false, 1);
-        } else {
-	    m_browser->GetHost()->SendMouseClickEvent(ev, MBT_LEFT, true, 0);
-	}
+std::string
+Renderer::url() const
+{
+    if (!m_browser) {
+        return m_url;
     }
+    return m_browser->GetMainFrame()->GetURL().ToString();
+}
+
+Geometry
+Renderer::geometry() const
+{
+    Geometry geometry;
+    glfwGetWindowSize(m_window, &geometry.width, &geometry.height);
+    glfwGetWindowPos(m_window, &geometry.x, &geometry.y);
+    geometry.positioned = true;
+    return geometry;
+}
+
+double
+Renderer::inputTimeout() const
+{
+    double timeout = m_input.timeout();
+    if (m_ingest) {
+        double ingest = m_ingest->timeout();
+        if (timeout < 0 || (ingest >= 0 && ingest < timeout)) {
+            timeout = ingest;
+        }
+    }
+    if (m_resizePending) {
+        int64_t due = m_resizeDue() - Stats::now();
+        double resize = due > 0 ? due / 1e9 : 0;
+        if (timeout < 0 || resize < timeout) {
+            timeout = resize;
+        }
+    }
+    if (m_pacer) {
+        int64_t due = m_pacer->timeout(Stats::now());
+        if (due >= 0 && (timeout < 0 || due / 1e9 < timeout)) {
+            timeout = due / 1e9;
+        }
+    }
+    if (m_probe) {
+        int64_t due = m_probe->timeout(Stats::now());
+        if (due >= 0 && (timeout < 0 || due / 1e9 < timeout)) {
+            timeout = due / 1e9;
+        }
+    }
+    return timeout;
 }
 
 void
-Renderer::mainLoop()
+Renderer::flushInput()
 {
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    while (!glfwWindowShouldClose(m_window)) {
-        CefDoMessageLoopWork();
-        glClear(GL_COLOR_BUFFER_BIT);
+    m_adoptBrowser();
+    if (!m_browser) {
+        /* Input waits for the browser */
+        return;
+    }
+    int64_t now = Stats::now();
+    if (m_probe && m_probe->clickDue(now)) {
+        /* Through the same queue as the window's own clicks */
+        onMouseMove(LatencyProbe::CLICK_X, LatencyProbe::CLICK_Y);
+        onMouseClick(GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, 0);
+        onMouseClick(GLFW_MOUSE_BUTTON_LEFT, GLFW_RELEASE, 0);
+        m_probe->clicked(now);
+    }
+    m_flushResize();
+    m_input.flush(m_browser->GetHost());
+    if (m_ingest) {
+        m_ingest->flush(m_browser);
+    }
+}
 
-        m_render();
+void
+Renderer::frame()
+{
+    m_adoptBrowser();
+    bool painted = m_renderHandler->takePainted();
+    if (painted) {
+        m_governor.onPaint();
+    }
+    m_governor.update();
+    m_updateInputRegion();
+    bool presented = m_compositor->frame(painted);
+    if (m_startup && presented && painted) {
+        m_startup->mark(StartupReport::FIRST_FRAME);
+        StartupReport::get()->update();
+        m_startup = nullptr;
+    }
+    if (m_probe) {
+        if (presented) {
+            m_probe->presented(Stats::now());
+        }
+        if (m_probe->done() && !shouldClose()) {
+            m_probe->report(std::cerr);
+            glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+        }
+    }
 
-        glfwSwapBuffers(m_window);
-        glfwPollEvents();
+    if (m_pacer && m_browser) {
+        int64_t now = Stats::now();
+        if (presented) {
+            m_pacer->presented(now, painted);
+        }
+        m_pacer->setRate(m_governor.fps());
+        if (m_pacer->due(now)) {
+            m_browser->GetHost()->SendExternalBeginFrame();
+            m_pacer->sent(now);
+        }
     }
 }
 
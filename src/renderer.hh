@@ -25,59 +25,236 @@
 #ifndef NNM_RENDERER_HH_
 #define NNM_RENDERER_HH_
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "browser.hh"
+#include "compositor.hh"
+#include "ingest.hh"
+#include "input.hh"
+#include "probe.hh"
+#include "pump.hh"
+#include "startup.hh"
+#include "stats.hh"
+#include "surface.hh"
+#include "surfaceless.hh"
+#include "throttle.hh"
 
 namespace nanamo {
 
+struct Geometry {
+    int width = 640;
+    int height = 480;
+    bool positioned = false;
+    int x = 0;
+    int y = 0;
+};
+
+/** Parse WxH[+X+Y] into geometry */
+bool parseGeometry(const char* str, Geometry& geometry);
+
 struct RendererOptions {
     bool border = false;
     bool resizable = false;
     bool transparent = false;
     std::string url = "";
+
+    int width = 640;
+    int height = 480;
+    /* Leave placement to the window manager unless positioned is set */
+    bool positioned = false;
+    int x = 0;
+    int y = 0;
+
+    FrameRateOptions frameRate;
+
+    /* Rasterize at renderScale times window resolution, and sharpen by
+     * sharpness (0 to 1) when drawing */
+    float renderScale = 1.0f;
+    float sharpness = 0.0f;
+
+    /* Let input through where the page's alpha is at most hitAlpha */
+    bool clickThrough = false;
+    uint8_t hitAlpha = 0;
+
+    /* Publish frames on this Unix socket, if not empty */
+    std::string exportPath = "";
+    /* Record paints to this file, if not empty */
+    std::string recordPath = "";
+    /* Take data for the page on this Unix socket, if not empty */
+    std::string ingestPath = "";
+
+    /* Drop the parts of paints whose pixels did not change */
+    bool shrinkDamage = false;
+
+    /* Drive the browser's frames with external BeginFrames after presents */
+    bool beginFrames = false;
+    /* glfwSwapInterval() for the window, negative leaves the default */
+    int swapInterval = -1;
+
+    /* Click a probe page this many times, then close, see LatencyProbe */
+    int latencyProbe = 0;
+
+    /* CEF runs on its own thread, paints arrive there */
+    bool threaded = false;
 };
 
-class Renderer {
+/** How RenderContext creates GL contexts */
+enum class ContextApi {
+    /* GLFW windows, through the platform's default API */
+    NATIVE,
+    /* GLFW windows, through EGL */
+    EGL,
+    /* EGL without any window system, for offscreen overlays only */
+    SURFACELESS,
+};
+
+/**
+ * GL state shared by every overlay.
+ *
+ * Owns GLFW, and a hidden window whose context every overlay window shares
+ * objects with; or, without a window system, a single surfaceless context
+ * that offscreen overlays all draw in. The shader program, quad buffers and
+ * all overlay textures live here; paint uploads happen with this context
+ * current.
+ */
+class RenderContext {
   private:
+    ContextApi m_api;
     GLFWwindow* m_window = nullptr;
+    std::unique_ptr<SurfacelessContext> m_surfaceless;
 
     GLuint m_program;
-    GLuint m_vertexArray;
     GLuint m_vertexBuffer;
     GLuint m_uvBuffer;
-    GLuint m_texture;
     GLuint m_posLocation;
     GLuint m_uvLocation;
-    GLuint m_texLocation;
+    GLint m_texLocation;
+    GLint m_frameSizeLocation;
+    GLint m_sharpnessLocation;
+
+    void m_createWindow();
+    void m_createProgram();
+    void m_initBuffers();
 
-    double m_mouseX;
-    double m_mouseY;
+  public:
+    explicit RenderContext(ContextApi api = ContextApi::NATIVE);
+    ~RenderContext();
+
+    RenderContext(const RenderContext&) = delete;
+    RenderContext& operator=(const RenderContext&) = delete;
+
+    void makeCurrent();
+    /** The hidden window, null for a surfaceless context */
+    GLFWwindow* window() const;
+    /** Set GLFW hints for a window whose context shares ours */
+    void contextHints() const;
+
+    /**
+     * Draw a full viewport quad sampling the top-left width x height texels
+     * of texture, VAO must be bound. A non-zero sharpness applies an unsharp
+     * mask to counter upscaling blur.
+     */
+    void drawQuad(GLuint texture, int width, int height,
+                  float sharpness = 0.0f);
+};
+
+class Renderer {
+  private:
+    /* Pass a new size to the browser once it stops changing for this
+     * long, or this long after the last one while it keeps changing */
+    static constexpr int64_t RESIZE_SETTLE_NS = 50000000;
+    static constexpr int64_t RESIZE_INTERVAL_NS = 200000000;
+
+    RenderContext& m_context;
+    GLFWwindow* m_window = nullptr;
+    std::string m_url;
+    bool m_focused = false;
+    /* Null once startup was reported on */
+    StartupReport::Overlay* m_startup = nullptr;
+
+    InputQueue m_input;
+    std::unique_ptr<IngestServer> m_ingest;
+
+    bool m_resizePending = false;
+    int m_resizeWidth = 0;
+    int m_resizeHeight = 0;
+    int64_t m_lastResize = 0;
+    int64_t m_lastResizeSent = 0;
+
+    std::optional<WindowSurface> m_surface;
+    std::optional<Compositor> m_compositor;
+
+    FrameRateGovernor m_governor;
+    std::optional<BeginFramePacer> m_pacer;
+    std::optional<LatencyProbe> m_probe;
+
+    std::vector<CefRect> m_inputRegion;
+    bool m_inputRegionSupported = true;
 
     CefRefPtr<BrowserRenderHandler> m_renderHandler;
     CefRefPtr<BrowserClient> m_browserClient;
+    /* Null until created */
     CefRefPtr<CefBrowser> m_browser;
 
     void m_createWindow(const RendererOptions&);
-    void m_createProgram();
-    void m_initBuffers();
-    void m_initTexture();
     void m_spawnBrowser(const RendererOptions&);
+    void m_adoptBrowser();
 
-    void m_render();
+    int64_t m_resizeDue() const;
+    void m_flushResize();
+    void m_updateRefreshRate();
+    void m_updateInputRegion();
 
   public:
-    Renderer(const RendererOptions&);
+    Renderer(const RendererOptions&, RenderContext&);
     ~Renderer();
 
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
     void onResize(int width, int height);
+    void onRefresh();
+    void onMove();
+    void onFocus(bool focused);
+    void onIconify(bool iconified);
     void onMouseMove(double x, double y);
-    void onMouseClick(int button, int action);
+    void onMouseEnter(bool entered);
+    void onMouseClick(int button, int action, int mods);
+    void onScroll(double dx, double dy);
+    void onKey(int key, int scancode, int action, int mods);
+    void onChar(unsigned int codepoint);
+
+    bool shouldClose() const;
+    /** Whether a new frame waits for takeFrame() */
+    bool frameReady() const;
+    /** Upload a new frame painted on CEF's thread, see enableMailbox() */
+    void takeFrame();
+
+    void reload();
+    void move(int x, int y);
+    void resize(int width, int height);
+    std::string url() const;
+    Geometry geometry() const;
 
-    void mainLoop();
+    /**
+     * Seconds until queued input, a resize, ingested data or a BeginFrame
+     * is due, negative if there is none
+     */
+    double inputTimeout() const;
+    /**
+     * Forward queued input, resizes and ingested data to the browser if
+     * they are due
+     */
+    void flushInput();
+    /** Redraw and present if anything changed since the last frame */
+    void frame();
 };
 
 } // namespace nanamo
@@ -0,0 +1,45 @@
+/** socket.hh -- System call error and socket helper definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_SOCKET_HH_
+#define NNM_SOCKET_HH_
+
+#include <stdexcept>
+#include <string>
+
+namespace nanamo {
+
+/** An error saying what failed along with strerror(errno) */
+std::runtime_error systemError(const std::string& what);
+
+/**
+ * Create a listening Unix socket of type (SOCK_STREAM, SOCK_SEQPACKET, ...)
+ * at path, replacing a socket left behind by an earlier run. The returned
+ * fd is close-on-exec. Throws std::runtime_error on failure.
+ */
+int listenUnix(const std::string& path, int type);
+
+} // namespace nanamo
+
+#endif /* NNM_SOCKET_HH_ */
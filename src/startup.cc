@@ -0,0 +1,188 @@
+/** startup.cc -- Startup timing implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "startup.hh"
+#include "stats.hh"
+
+namespace nanamo {
+
+static const char* milestoneNames[StartupReport::MILESTONES] = {
+    "window",
+    "browser",
+    "first paint",
+    "first frame",
+};
+
+/* Process start time on the steady clock, or now if /proc has none */
+static int64_t
+processStart(int64_t now)
+{
+    std::ifstream in("/proc/self/stat");
+    std::string stat((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    /* The command name may hold spaces, fields resume after its ')' */
+    size_t end = stat.rfind(')');
+    if (end == std::string::npos) {
+        return now;
+    }
+    std::istringstream fields(stat.substr(end + 2));
+    std::string field;
+    /* starttime is field 22, the 20th after the name */
+    for (int i = 0; i < 20 && fields >> field; i++) {
+    }
+    unsigned long long ticks = 0;
+    if (!(fields >> ticks)) {
+        return now;
+    }
+
+    /* starttime counts from boot, which the steady clock may not */
+    timespec boot;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    int64_t sinceBoot = int64_t(boot.tv_sec) * 1000000000 + boot.tv_nsec;
+    int64_t started = int64_t(ticks * 1000000000 / sysconf(_SC_CLK_TCK));
+    return now - (sinceBoot - started);
+}
+
+StartupReport* StartupReport::s_instance = nullptr;
+
+StartupReport::StartupReport()
+    : m_start(Stats::now()), m_exec(processStart(m_start))
+{
+}
+
+void
+StartupReport::enable()
+{
+    if (!s_instance) {
+        s_instance = new StartupReport();
+    }
+}
+
+StartupReport*
+StartupReport::get()
+{
+    return s_instance;
+}
+
+void
+StartupReport::Overlay::mark(Milestone milestone)
+{
+    int64_t unset = 0;
+    m_times[milestone].compare_exchange_strong(unset, Stats::now());
+}
+
+void
+StartupReport::mark(const std::string& name)
+{
+    std::unique_lock guard(m_lock);
+    m_phases.emplace_back(name, Stats::now());
+}
+
+StartupReport::Overlay*
+StartupReport::addOverlay(const std::string& url)
+{
+    std::unique_lock guard(m_lock);
+    if (m_reported) {
+        return nullptr;
+    }
+    return &m_overlays.emplace_back(url);
+}
+
+void
+StartupReport::update()
+{
+    std::unique_lock guard(m_lock);
+    if (m_reported || m_overlays.empty()) {
+        return;
+    }
+    for (const auto& overlay : m_overlays) {
+        if (!overlay.m_times[FIRST_FRAME]) {
+            return;
+        }
+    }
+    m_print();
+}
+
+void
+StartupReport::finish()
+{
+    std::unique_lock guard(m_lock);
+    if (!m_reported) {
+        m_print();
+    }
+}
+
+void
+StartupReport::m_print()
+{
+    m_reported = true;
+
+    auto ms = [](int64_t ns) { return ns / 1e6; };
+    std::ostream& os = std::cerr;
+    auto flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "[startup] exec to main " << ms(m_start - m_exec) << "ms"
+       << std::endl;
+
+    int64_t last = m_start;
+    for (const auto& [name, time] : m_phases) {
+        os << "[startup] " << std::left << std::setw(20) << name
+           << std::right << std::setw(8) << ms(time - last) << "ms  (at "
+           << ms(time - m_start) << "ms)" << std::endl;
+        last = time;
+    }
+
+    /* Overlays from main, milestones since it started */
+    for (size_t i = 0; i < m_overlays.size(); i++) {
+        const Overlay& overlay = m_overlays[i];
+        os << "[startup] overlay " << i << " " << overlay.m_url << std::endl;
+        for (int m = 0; m < MILESTONES; m++) {
+            int64_t time = overlay.m_times[m];
+            if (!time && m == WINDOW) {
+                /* Headless */
+                continue;
+            }
+            os << "[startup]   " << std::left << std::setw(18)
+               << milestoneNames[m] << std::right;
+            if (time) {
+                os << std::setw(8) << ms(time - m_start) << "ms";
+            } else {
+                os << std::setw(10) << "never";
+            }
+            os << std::endl;
+        }
+    }
+    os.flags(flags);
+}
+
+} // namespace nanamo
@@ -0,0 +1,109 @@
+/** startup.hh -- Startup timing definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_STARTUP_HH_
+#define NNM_STARTUP_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nanamo {
+
+/**
+ * Milestones of startup, printed by --startup-report.
+ *
+ * main marks the end of each process-wide phase; every overlay created
+ * before the report marks when its window, browser, first paint and first
+ * presented frame were ready. The report goes to stderr once every overlay
+ * has presented, or at exit.
+ */
+class StartupReport {
+  public:
+    enum Milestone {
+        WINDOW,
+        BROWSER,
+        FIRST_PAINT,
+        FIRST_FRAME,
+        MILESTONES,
+    };
+
+    class Overlay {
+      private:
+        friend class StartupReport;
+
+        std::string m_url;
+        /* Nanoseconds, 0 until reached; browsers and paints may arrive on
+         * CEF's thread */
+        std::atomic<int64_t> m_times[MILESTONES] = {};
+
+      public:
+        explicit Overlay(const std::string& url) : m_url(url) {}
+
+        /** Record the first time milestone is reached */
+        void mark(Milestone milestone);
+    };
+
+  private:
+    static StartupReport* s_instance;
+
+    int64_t m_start;
+    /* Process start, from /proc, before main ran */
+    int64_t m_exec;
+
+    std::vector<std::pair<std::string, int64_t>> m_phases;
+    std::mutex m_lock;
+    std::deque<Overlay> m_overlays;
+    bool m_reported = false;
+
+    StartupReport();
+
+    void m_print();
+
+  public:
+    /** Start timing, as early in main as possible */
+    static void enable();
+    /** The report, or null if not enabled */
+    static StartupReport* get();
+
+    /** End a process-wide phase named name */
+    void mark(const std::string& name);
+    /**
+     * Register an overlay to report on, null once the report was printed.
+     * The overlay stays valid for the process lifetime.
+     */
+    Overlay* addOverlay(const std::string& url);
+    /** Print the report if every overlay has presented its first frame */
+    void update();
+    /** Print the report if not done yet, with whatever was reached */
+    void finish();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_STARTUP_HH_ */
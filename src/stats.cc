@@ -0,0 +1,352 @@
+/** stats.cc -- Performance statistics implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "stats.hh"
+
+namespace nanamo {
+
+int
+Histogram::m_bucketOf(uint64_t value)
+{
+    if (value < SUB_COUNT) {
+        return value;
+    }
+    int shift = 63 - std::countl_zero(value) - SUB_BITS;
+    int sub = (value >> shift) & (SUB_COUNT - 1);
+    return (shift + 1) * SUB_COUNT + sub;
+}
+
+uint64_t
+Histogram::m_bucketValue(int bucket)
+{
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    int shift = bucket / SUB_COUNT - 1;
+    uint64_t lower = uint64_t(SUB_COUNT + bucket % SUB_COUNT) << shift;
+    return lower + (uint64_t(1) << shift) / 2;
+}
+
+void
+Histogram::record(uint64_t value)
+{
+    m_buckets[m_bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max &&
+           !m_max.compare_exchange_weak(max, value,
+                                        std::memory_order_relaxed)) {
+    }
+}
+
+Histogram::Summary
+Histogram::take()
+{
+    uint64_t counts[BUCKET_COUNT];
+    Summary summary;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = m_buckets[i].exchange(0, std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    summary.max = m_max.exchange(0, std::memory_order_relaxed);
+    if (!summary.count) {
+        return summary;
+    }
+
+    uint64_t p50Rank = (summary.count + 1) / 2;
+    uint64_t p99Rank = (summary.count * 99 + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        if (!counts[i]) {
+            continue;
+        }
+        uint64_t value = std::min(m_bucketValue(i), summary.max);
+        if (seen < p50Rank && seen + counts[i] >= p50Rank) {
+            summary.p50 = value;
+        }
+        if (seen < p99Rank && seen + counts[i] >= p99Rank) {
+            summary.p99 = value;
+            break;
+        }
+        seen += counts[i];
+    }
+    return summary;
+}
+
+GpuTimer::GpuTimer(Histogram& elapsed, Histogram* latency)
+    : m_elapsed(elapsed), m_latency(latency)
+{
+}
+
+void
+GpuTimer::m_collect()
+{
+    for (auto& query : m_queries) {
+        if (!query.pending) {
+            continue;
+        }
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;
+        }
+
+        GLint64 begin, end;
+        glGetQueryObjecti64v(query.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjecti64v(query.end, GL_QUERY_RESULT, &end);
+        m_elapsed.record(std::max<GLint64>(end - begin, 0));
+        if (m_latency && query.origin >= 0) {
+            m_latency->record(std::max<GLint64>(end - query.origin, 0));
+        }
+        query.pending = false;
+    }
+}
+
+void
+GpuTimer::begin()
+{
+    m_collect();
+
+    Query& query = m_queries[m_next];
+    if (query.pending) {
+        /* GPU is too far behind, skip this measurement */
+        m_current = nullptr;
+        return;
+    }
+    if (!query.begin) {
+        glGenQueries(1, &query.begin);
+        glGenQueries(1, &query.end);
+    }
+
+    query.origin = -1;
+    if (m_latency) {
+        glGetInteger64v(GL_TIMESTAMP, &query.origin);
+    }
+    glQueryCounter(query.begin, GL_TIMESTAMP);
+    m_current = &query;
+    m_next = (m_next + 1) % QUERY_COUNT;
+}
+
+void
+GpuTimer::end()
+{
+    if (!m_current) {
+        return;
+    }
+    glQueryCounter(m_current->end, GL_TIMESTAMP);
+    m_current->pending = true;
+    m_current = nullptr;
+}
+
+void
+GpuTimer::release()
+{
+    for (auto& query : m_queries) {
+        if (query.begin) {
+            glDeleteQueries(1, &query.begin);
+            glDeleteQueries(1, &query.end);
+        }
+        query = Query();
+    }
+    m_current = nullptr;
+}
+
+Stats* Stats::s_instance = nullptr;
+
+Stats::Stats(const std::string& path, double interval)
+    : m_interval(interval * 1e9), m_start(now()), m_lastReport(m_start),
+      m_memory(m_interval)
+{
+    if (!path.empty()) {
+        m_file.open(path, std::ios::out | std::ios::trunc);
+        if (!m_file) {
+            throw std::runtime_error("failed to open stats file " + path);
+        }
+        m_json = true;
+    }
+}
+
+void
+Stats::enable(const std::string& path, double interval)
+{
+    if (!s_instance) {
+        s_instance = new Stats(path, interval);
+    }
+}
+
+Stats*
+Stats::get()
+{
+    return s_instance;
+}
+
+int64_t
+Stats::now()
+{
+    using namespace std::chrono;
+    auto now = steady_clock::now().time_since_epoch();
+    return duration_cast<nanoseconds>(now).count();
+}
+
+void
+Stats::tick()
+{
+    if (now() - m_lastReport >= m_interval) {
+        report();
+    }
+}
+
+void
+Stats::report()
+{
+    int64_t t = now();
+    double elapsed = (t - m_lastReport) / 1e9;
+    m_lastReport = t;
+    if (elapsed <= 0) {
+        return;
+    }
+
+    if (m_json) {
+        m_writeJSON(m_file, elapsed);
+        m_file.flush();
+    } else {
+        m_writeText(std::cerr, elapsed);
+    }
+}
+
+struct NamedHistogram {
+    const char* name;
+    Histogram Stats::*histogram;
+};
+
+static const NamedHistogram histograms[] = {
+    {"paint_cpu", &Stats::paintCpu},
+    {"upload_gpu", &Stats::uploadGpu},
+    {"upload_latency", &Stats::uploadLatency},
+    {"draw_gpu", &Stats::drawGpu},
+    {"loop_iteration", &Stats::loopIteration},
+    {"frame_interval", &Stats::frameInterval},
+    {"begin_frame_latency", &Stats::beginFrameLatency},
+    {"input_to_paint", &Stats::inputToPaint},
+    {"input_to_upload", &Stats::inputToUpload},
+    {"input_to_present", &Stats::inputToPresent},
+};
+
+void
+Stats::m_writeText(std::ostream& os, double elapsed)
+{
+    uint64_t p = paints.exchange(0);
+    uint64_t unchanged = unchangedPaints.exchange(0);
+    uint64_t s = swaps.exchange(0);
+    uint64_t partial = partialSwaps.exchange(0);
+    uint64_t bytes = uploadBytes.exchange(0);
+    uint64_t messages = ingestMessages.exchange(0);
+    uint64_t ingested = ingestBytes.exchange(0);
+    uint64_t begun = beginFrames.exchange(0);
+    uint64_t late = lateFrames.exchange(0);
+
+    auto flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "[stats] " << elapsed << "s: " << p / elapsed << " paints/s ("
+       << unchanged / elapsed << " unchanged), " << s / elapsed
+       << " swaps/s (" << partial / elapsed << " partial), "
+       << bytes / elapsed / 1e6 << " MB/s uploaded" << std::endl;
+    if (messages) {
+        os << "[stats]   ingest " << messages / elapsed << " messages/s, "
+           << ingested / elapsed / 1e6 << " MB/s" << std::endl;
+    }
+    if (begun) {
+        os << "[stats]   begin frames " << begun / elapsed << "/s, " << late
+           << " late" << std::endl;
+    }
+
+    os << std::setprecision(3);
+    for (const auto& h : histograms) {
+        auto summary = (this->*h.histogram).take();
+        if (!summary.count) {
+            continue;
+        }
+        os << "[stats]   " << std::left << std::setw(20) << h.name
+           << std::right << "n " << std::setw(6) << summary.count << "  p50 "
+           << summary.p50 / 1e6 << "ms  p99 " << summary.p99 / 1e6
+           << "ms  max " << summary.max / 1e6 << "ms" << std::endl;
+    }
+
+    os << std::setprecision(1);
+    for (const auto& memory : m_memory.latest()) {
+        os << "[stats]   mem " << std::left << std::setw(16) << memory.type
+           << std::right << "n " << std::setw(6) << memory.processes
+           << "  rss " << memory.rss / 1e6 << "MB  pss " << memory.pss / 1e6
+           << "MB" << std::endl;
+    }
+    os.flags(flags);
+}
+
+void
+Stats::m_writeJSON(std::ostream& os, double elapsed)
+{
+    uint64_t p = paints.exchange(0);
+    uint64_t unchanged = unchangedPaints.exchange(0);
+    uint64_t s = swaps.exchange(0);
+    uint64_t partial = partialSwaps.exchange(0);
+    uint64_t bytes = uploadBytes.exchange(0);
+    uint64_t messages = ingestMessages.exchange(0);
+    uint64_t ingested = ingestBytes.exchange(0);
+    uint64_t begun = beginFrames.exchange(0);
+    uint64_t late = lateFrames.exchange(0);
+
+    os << "{\"time\":" << (now() - m_start) / 1e9 << ",\"interval\":" << elapsed
+       << ",\"paints\":" << p << ",\"unchanged_paints\":" << unchanged
+       << ",\"swaps\":" << s
+       << ",\"partial_swaps\":" << partial << ",\"upload_bytes\":" << bytes
+       << ",\"ingest_messages\":" << messages
+       << ",\"ingest_bytes\":" << ingested << ",\"begin_frames\":" << begun
+       << ",\"late_frames\":" << late;
+    for (const auto& h : histograms) {
+        auto summary = (this->*h.histogram).take();
+        os << ",\"" << h.name << "\":{\"count\":" << summary.count
+           << ",\"p50_ns\":" << summary.p50 << ",\"p99_ns\":" << summary.p99
+           << ",\"max_ns\":" << summary.max << "}";
+    }
+
+    os << ",\"memory\":{";
+    const char* sep = "";
+    for (const auto& memory : m_memory.latest()) {
+        os << sep << "\"" << memory.type << "\":{\"processes\":"
+           << memory.processes << ",\"rss_bytes\":" << memory.rss
+           << ",\"pss_bytes\":" << memory.pss << "}";
+        sep = ",";
+    }
+    os << "}}" << std::endl;
+}
+
+} // namespace nanamo
@@ -0,0 +1,183 @@
+/** stats.hh -- Performance statistics definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_STATS_HH_
+#define NNM_STATS_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "memory.hh"
+
+namespace nanamo {
+
+/**
+ * Log-linear histogram with lock-free recording.
+ *
+ * Each power of two is split into 8 linear buckets, which keeps the relative
+ * error of reported percentiles under 12.5% at a fixed 4KB per histogram.
+ */
+class Histogram {
+  public:
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t p50 = 0;
+        uint64_t p99 = 0;
+        uint64_t max = 0;
+    };
+
+  private:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int BUCKET_COUNT = 64 * SUB_COUNT;
+
+    std::atomic<uint64_t> m_buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> m_max = 0;
+
+    static int m_bucketOf(uint64_t value);
+    static uint64_t m_bucketValue(int bucket);
+
+  public:
+    void record(uint64_t value);
+    /** Summarize everything recorded since the last call and reset */
+    Summary take();
+};
+
+/**
+ * Times GL commands with timestamp queries, without stalling on results.
+ *
+ * Queries are kept in a small ring and collected once the GPU has written
+ * them; if every query is still in flight a measurement is skipped. Query
+ * objects are per context, so a timer must stay within one context.
+ */
+class GpuTimer {
+  private:
+    static constexpr int QUERY_COUNT = 8;
+
+    struct Query {
+        GLuint begin = 0;
+        GLuint end = 0;
+        GLint64 origin = -1;
+        bool pending = false;
+    };
+
+    Histogram& m_elapsed;
+    Histogram* m_latency;
+
+    Query m_queries[QUERY_COUNT];
+    int m_next = 0;
+    Query* m_current = nullptr;
+
+    void m_collect();
+
+  public:
+    /**
+     * GPU time between begin() and end() goes to elapsed; if latency is
+     * given, the time from the CPU calling begin() to the GPU reaching end()
+     * goes there as well.
+     */
+    GpuTimer(Histogram& elapsed, Histogram* latency = nullptr);
+
+    void begin();
+    void end();
+    /** Free query objects, the owning context must be current */
+    void release();
+};
+
+/**
+ * Process-wide performance counters, enabled with --stats.
+ *
+ * Instrumented code checks Stats::get() and skips all work when it is null,
+ * so disabled statistics cost one load per call site.
+ */
+class Stats {
+  public:
+    /* Nanoseconds unless noted otherwise */
+    Histogram paintCpu;
+    Histogram uploadGpu;
+    Histogram uploadLatency;
+    Histogram drawGpu;
+    Histogram loopIteration;
+    Histogram frameInterval;
+    /* From an external BeginFrame to the present of its paint */
+    Histogram beginFrameLatency;
+    /* From a --latency-probe click to its paint, upload and present */
+    Histogram inputToPaint;
+    Histogram inputToUpload;
+    Histogram inputToPresent;
+
+    std::atomic<uint64_t> paints = 0;
+    /* Of those, paints dropped as no pixel changed, see DamageShrinker */
+    std::atomic<uint64_t> unchangedPaints = 0;
+    std::atomic<uint64_t> swaps = 0;
+    /* Swaps after redrawing only the damaged part of the window */
+    std::atomic<uint64_t> partialSwaps = 0;
+    std::atomic<uint64_t> uploadBytes = 0;
+    std::atomic<uint64_t> ingestMessages = 0;
+    std::atomic<uint64_t> ingestBytes = 0;
+    std::atomic<uint64_t> beginFrames = 0;
+    /* Paints presented more than one present after their BeginFrame */
+    std::atomic<uint64_t> lateFrames = 0;
+
+  private:
+    static Stats* s_instance;
+
+    std::ofstream m_file;
+    bool m_json = false;
+    int64_t m_interval;
+    int64_t m_start;
+    int64_t m_lastReport;
+    /* Sampled in the background, reports show the latest sample */
+    MemorySampler m_memory;
+
+    void m_writeText(std::ostream&, double elapsed);
+    void m_writeJSON(std::ostream&, double elapsed);
+
+  public:
+    /**
+     * Enable statistics, reporting every interval seconds as JSON lines to
+     * path, or as text to stderr if path is empty
+     */
+    static void enable(const std::string& path, double interval);
+    static Stats* get();
+
+    static int64_t now();
+
+    /** Report if the interval has passed */
+    void tick();
+    /** Report everything since the last report */
+    void report();
+
+  private:
+    Stats(const std::string& path, double interval);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_STATS_HH_ */
@@ -0,0 +1,125 @@
+/** surface.cc -- Presentation surface implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdexcept>
+
+#include "renderer.hh"
+#include "surface.hh"
+
+namespace nanamo {
+
+WindowSurface::WindowSurface(GLFWwindow* window)
+    : m_window(window), m_presenter(window)
+{
+}
+
+void
+WindowSurface::makeCurrent()
+{
+    glfwMakeContextCurrent(m_window);
+}
+
+void
+WindowSurface::size(int& width, int& height) const
+{
+    glfwGetFramebufferSize(m_window, &width, &height);
+}
+
+bool
+WindowSurface::begin(int width, int height, const Presenter::Region& damage,
+                     Presenter::Region& redraw)
+{
+    return m_presenter.begin(width, height, damage, redraw);
+}
+
+void
+WindowSurface::present()
+{
+    m_presenter.present();
+}
+
+OffscreenSurface::OffscreenSurface(RenderContext& context, int width,
+                                   int height)
+    : m_context(context), m_width(width), m_height(height)
+{
+    m_context.makeCurrent();
+    glGenRenderbuffers(1, &m_renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, m_renderbuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_renderbuffer);
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
+    }
+}
+
+OffscreenSurface::~OffscreenSurface()
+{
+    m_context.makeCurrent();
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteRenderbuffers(1, &m_renderbuffer);
+}
+
+void
+OffscreenSurface::makeCurrent()
+{
+    m_context.makeCurrent();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+void
+OffscreenSurface::size(int& width, int& height) const
+{
+    width = m_width;
+    height = m_height;
+}
+
+bool
+OffscreenSurface::begin(int width, int height,
+                        const Presenter::Region& damage,
+                        Presenter::Region& redraw)
+{
+    /* Nothing else draws here, the last frame is all still in place */
+    redraw = damage;
+    bool full = damage.size() == 1 && damage[0].x == 0 &&
+                damage[0].y == 0 && damage[0].width >= width &&
+                damage[0].height >= height;
+    return !full;
+}
+
+void
+OffscreenSurface::present()
+{
+    /* Submit the frame; unlike a swap, nothing waits on it */
+    glFlush();
+}
+
+} // namespace nanamo
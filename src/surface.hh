@@ -0,0 +1,100 @@
+/** surface.hh -- Presentation surface definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_SURFACE_HH_
+#define NNM_SURFACE_HH_
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "present.hh"
+
+namespace nanamo {
+
+/**
+ * Where an overlay's frames are drawn, and how they are presented: a window
+ * on screen or an offscreen framebuffer.
+ */
+class Surface {
+  public:
+    virtual ~Surface() = default;
+
+    /** Make the surface's context current, with its framebuffer bound */
+    virtual void makeCurrent() = 0;
+    /** Framebuffer size in pixels */
+    virtual void size(int& width, int& height) const = 0;
+    /** Start a frame, as Presenter::begin() */
+    virtual bool begin(int width, int height, const Presenter::Region& damage,
+                       Presenter::Region& redraw) = 0;
+    /** Finish the frame begin() started */
+    virtual void present() = 0;
+};
+
+/** A GLFW window's back buffer, presented by swapping */
+class WindowSurface : public Surface {
+  private:
+    GLFWwindow* m_window;
+    Presenter m_presenter;
+
+  public:
+    explicit WindowSurface(GLFWwindow*);
+
+    void makeCurrent() override;
+    void size(int& width, int& height) const override;
+    bool begin(int width, int height, const Presenter::Region& damage,
+               Presenter::Region& redraw) override;
+    void present() override;
+};
+
+class RenderContext;
+
+/**
+ * A framebuffer object in the render context, for overlays nobody looks
+ * at. Its contents persist between frames, so only damage is redrawn.
+ */
+class OffscreenSurface : public Surface {
+  private:
+    RenderContext& m_context;
+    GLuint m_framebuffer = 0;
+    GLuint m_renderbuffer = 0;
+    int m_width;
+    int m_height;
+
+  public:
+    OffscreenSurface(RenderContext&, int width, int height);
+    ~OffscreenSurface();
+
+    OffscreenSurface(const OffscreenSurface&) = delete;
+    OffscreenSurface& operator=(const OffscreenSurface&) = delete;
+
+    void makeCurrent() override;
+    void size(int& width, int& height) const override;
+    bool begin(int width, int height, const Presenter::Region& damage,
+               Presenter::Region& redraw) override;
+    void present() override;
+};
+
+} // namespace nanamo
+
+#endif /* NNM_SURFACE_HH_ */
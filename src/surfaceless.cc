@@ -0,0 +1,138 @@
+/** surfaceless.cc -- Surfaceless EGL context implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdexcept>
+
+#include "present.hh"
+#include "surfaceless.hh"
+
+#ifdef NNM_WITH_EGL
+#    include <EGL/egl.h>
+#    include <EGL/eglext.h>
+#endif
+
+namespace nanamo {
+
+#ifdef NNM_WITH_EGL
+
+struct SurfacelessContext::Native {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+SurfacelessContext::SurfacelessContext() : m_native(new Native)
+{
+    const char* clientExts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (!hasExtension(clientExts, "EGL_MESA_platform_surfaceless")) {
+        throw std::runtime_error("EGL has no surfaceless platform");
+    }
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay) {
+        throw std::runtime_error("eglGetPlatformDisplayEXT missing");
+    }
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                            EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY ||
+        !eglInitialize(display, nullptr, nullptr)) {
+        throw std::runtime_error("Failed to initialize surfaceless EGL");
+    }
+    m_native->display = display;
+
+    const char* exts = eglQueryString(display, EGL_EXTENSIONS);
+    if (!hasExtension(exts, "EGL_KHR_surfaceless_context") ||
+        !eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(display);
+        throw std::runtime_error("EGL cannot do surfaceless desktop GL");
+    }
+
+    /* Rendering only ever goes to framebuffer objects, any config does */
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!hasExtension(exts, "EGL_KHR_no_config_context")) {
+        static const EGLint configAttribs[] = {
+            /* clang-format off */
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE,
+            /* clang-format on */
+        };
+        EGLint count = 0;
+        eglChooseConfig(display, configAttribs, &config, 1, &count);
+        if (count < 1) {
+            eglTerminate(display);
+            throw std::runtime_error("No EGL config for desktop GL");
+        }
+    }
+
+    static const EGLint contextAttribs[] = {
+        /* clang-format off */
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+        /* clang-format on */
+    };
+    m_native->context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (m_native->context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        throw std::runtime_error("Failed to create a GL 4.5 EGL context");
+    }
+    makeCurrent();
+}
+
+SurfacelessContext::~SurfacelessContext()
+{
+    eglMakeCurrent(m_native->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    eglDestroyContext(m_native->display, m_native->context);
+    eglTerminate(m_native->display);
+}
+
+void
+SurfacelessContext::makeCurrent()
+{
+    eglMakeCurrent(m_native->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   m_native->context);
+}
+
+#else
+
+struct SurfacelessContext::Native {
+};
+
+SurfacelessContext::SurfacelessContext()
+{
+    throw std::runtime_error("Built without EGL, no surfaceless contexts");
+}
+
+SurfacelessContext::~SurfacelessContext() = default;
+
+void
+SurfacelessContext::makeCurrent()
+{
+}
+
+#endif
+
+} // namespace nanamo
@@ -0,0 +1,56 @@
+/** surfaceless.hh -- Surfaceless EGL context definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_SURFACELESS_HH_
+#define NNM_SURFACELESS_HH_
+
+#include <memory>
+
+namespace nanamo {
+
+/**
+ * A GL 4.5 core context on EGL's surfaceless platform, without any window
+ * system. Mesa provides it on GPU render nodes, and with llvmpipe where
+ * there are none (LIBGL_ALWAYS_SOFTWARE=1 forces it).
+ */
+class SurfacelessContext {
+  private:
+    struct Native;
+
+    std::unique_ptr<Native> m_native;
+
+  public:
+    /** Throws if EGL or its surfaceless platform is unavailable */
+    SurfacelessContext();
+    ~SurfacelessContext();
+
+    SurfacelessContext(const SurfacelessContext&) = delete;
+    SurfacelessContext& operator=(const SurfacelessContext&) = delete;
+
+    void makeCurrent();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_SURFACELESS_HH_ */
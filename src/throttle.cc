@@ -0,0 +1,190 @@
+/** throttle.cc -- Browser frame rate throttling implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "stats.hh"
+#include "throttle.hh"
+
+namespace nanamo {
+
+FrameRateGovernor::FrameRateGovernor(const FrameRateOptions& opts)
+    : m_opts(opts), m_lastPaint(Stats::now())
+{
+}
+
+int
+FrameRateGovernor::m_activeFps() const
+{
+    int fps = m_opts.fps > 0 ? m_opts.fps : m_refreshRate;
+    return std::max(fps, 1);
+}
+
+int
+FrameRateGovernor::m_targetFps() const
+{
+    int fps = m_activeFps();
+    if (!m_focused && m_opts.unfocusedFps > 0) {
+        fps = std::min(fps, m_opts.unfocusedFps);
+    }
+    if (m_idle) {
+        fps = std::min(fps, m_opts.idleFps);
+    }
+    return fps;
+}
+
+int
+FrameRateGovernor::initialFps()
+{
+    m_appliedFps = m_targetFps();
+    return m_appliedFps;
+}
+
+void
+FrameRateGovernor::setBrowser(CefRefPtr<CefBrowser> browser)
+{
+    /* Browsers are created asynchronously, catch up with what happened
+     * since; update() applies any changed rate */
+    m_browser = browser;
+    if (m_hidden) {
+        m_browser->GetHost()->WasHidden(true);
+    }
+}
+
+void
+FrameRateGovernor::setRefreshRate(int hz)
+{
+    if (hz > 0) {
+        m_refreshRate = hz;
+    }
+}
+
+void
+FrameRateGovernor::onPaint()
+{
+    m_lastPaint = Stats::now();
+    m_idle = false;
+}
+
+void
+FrameRateGovernor::onFocus(bool focused)
+{
+    m_focused = focused;
+}
+
+void
+FrameRateGovernor::onIconify(bool iconified)
+{
+    if (iconified == m_hidden) {
+        return;
+    }
+    m_hidden = iconified;
+    if (m_browser) {
+        m_browser->GetHost()->WasHidden(iconified);
+    }
+    if (!iconified) {
+        /* Nothing was painted while hidden, don't count that as idle */
+        onPaint();
+    }
+}
+
+void
+FrameRateGovernor::update()
+{
+    if (m_opts.idleFps > 0 && m_opts.idleTimeout > 0 && !m_hidden) {
+        int64_t quiet = Stats::now() - m_lastPaint;
+        if (quiet >= int64_t(m_opts.idleTimeout * 1e9)) {
+            m_idle = true;
+        }
+    }
+
+    int fps = m_targetFps();
+    if (m_browser && fps != m_appliedFps) {
+        m_browser->GetHost()->SetWindowlessFrameRate(fps);
+        m_appliedFps = fps;
+    }
+}
+
+int
+FrameRateGovernor::fps() const
+{
+    return m_hidden ? 0 : m_targetFps();
+}
+
+void
+BeginFramePacer::setRate(int fps)
+{
+    m_interval = fps > 0 ? int64_t(1e9) / fps : 0;
+}
+
+int64_t
+BeginFramePacer::timeout(int64_t now) const
+{
+    if (!m_interval) {
+        return -1;
+    }
+    return std::max<int64_t>(m_next - now, 0);
+}
+
+bool
+BeginFramePacer::due(int64_t now) const
+{
+    return m_interval && now >= m_next;
+}
+
+void
+BeginFramePacer::sent(int64_t now)
+{
+    m_lastSent = now;
+    m_next = now + m_interval;
+    m_pending = now;
+    m_presents = 0;
+
+    if (Stats* stats = Stats::get()) {
+        stats->beginFrames++;
+    }
+}
+
+void
+BeginFramePacer::presented(int64_t now, bool painted)
+{
+    m_presents++;
+    if (painted && m_pending) {
+        if (Stats* stats = Stats::get()) {
+            stats->beginFrameLatency.record(now - m_pending);
+            if (m_presents > 1) {
+                stats->lateFrames++;
+            }
+        }
+        m_pending = 0;
+    }
+
+    /* Swaps wait for vblank, so this is the display's cadence. Allow for a
+     * little jitter between it and the interval, without raising the rate
+     * past the one asked for. */
+    int64_t slack = std::min(m_interval / 4, MAX_SLACK);
+    m_next = std::max(now, m_lastSent + m_interval - slack);
+}
+
+} // namespace nanamo
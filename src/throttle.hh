@@ -0,0 +1,118 @@
+/** throttle.hh -- Browser frame rate throttling definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_THROTTLE_HH_
+#define NNM_THROTTLE_HH_
+
+#include <cstdint>
+
+#include <cef_browser.h>
+
+namespace nanamo {
+
+struct FrameRateOptions {
+    /* Rate while visible and active, 0 to follow the monitor refresh */
+    int fps = 60;
+    /* Rate once no paint arrived for idleTimeout seconds, 0 disables */
+    int idleFps = 15;
+    double idleTimeout = 5.0;
+    /* Rate while the window is unfocused, 0 keeps the active rate */
+    int unfocusedFps = 0;
+};
+
+/**
+ * Picks the windowless frame rate of a browser from what the user can see.
+ *
+ * An iconified window hides the browser entirely, so CEF stops producing
+ * frames. Otherwise the rate drops to unfocusedFps while unfocused and to
+ * idleFps after a quiet period; the first paint after that restores it.
+ */
+class FrameRateGovernor {
+  private:
+    FrameRateOptions m_opts;
+    CefRefPtr<CefBrowser> m_browser;
+
+    int m_refreshRate = 60;
+    int m_appliedFps = 0;
+    bool m_hidden = false;
+    bool m_focused = false;
+    bool m_idle = false;
+    int64_t m_lastPaint;
+
+    int m_activeFps() const;
+    int m_targetFps() const;
+
+  public:
+    explicit FrameRateGovernor(const FrameRateOptions&);
+
+    /** Rate to create the browser with */
+    int initialFps();
+    void setBrowser(CefRefPtr<CefBrowser>);
+
+    void setRefreshRate(int hz);
+    void onPaint();
+    void onFocus(bool focused);
+    void onIconify(bool iconified);
+
+    /** Apply idle transitions and any changed rate to the browser */
+    void update();
+    /** The current frame rate, 0 while hidden */
+    int fps() const;
+};
+
+/**
+ * Paces a browser's external BeginFrames, see --begin-frames.
+ *
+ * A BeginFrame goes out right after each present, so the frame it produces
+ * is ready for the next one; while nothing is presented, they go out at the
+ * frame rate on their own. The time from a BeginFrame to the present of its
+ * paint is recorded, along with paints that missed the present after it.
+ */
+class BeginFramePacer {
+  private:
+    /* How early a present may release the next BeginFrame */
+    static constexpr int64_t MAX_SLACK = 1'000'000;
+
+    int64_t m_interval = 0;
+    int64_t m_lastSent = 0;
+    int64_t m_next = 0;
+    /* When the BeginFrame whose paint is awaited went out, 0 for none */
+    int64_t m_pending = 0;
+    int m_presents = 0;
+
+  public:
+    /** BeginFrames per second, 0 stops them */
+    void setRate(int fps);
+
+    /** Nanoseconds until the next BeginFrame is due, negative if never */
+    int64_t timeout(int64_t now) const;
+    bool due(int64_t now) const;
+    void sent(int64_t now);
+    /** A frame was presented, showing a new paint if painted */
+    void presented(int64_t now, bool painted);
+};
+
+} // namespace nanamo
+
+#endif /* NNM_THROTTLE_HH_ */
@@ -0,0 +1,181 @@
+/** trace.cc -- Trace capture implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <cef_trace.h>
+
+#include <unistd.h>
+
+#include "app.hh"
+#include "trace.hh"
+
+namespace nanamo {
+
+/* Upper bound on the wait for Chromium's trace at shutdown */
+static constexpr int64_t END_TIMEOUT_NS = 10'000'000'000;
+
+class Tracer::EndCallback : public CefEndTracingCallback {
+  private:
+    Tracer* m_tracer;
+
+  public:
+    explicit EndCallback(Tracer* tracer) : m_tracer(tracer)
+    {
+    }
+
+    void OnEndTracingComplete(const CefString& path) override
+    {
+        (void)path;
+        m_tracer->m_chromeDone = true;
+        m_tracer->m_pump->wake();
+    }
+
+    IMPLEMENT_REFCOUNTING(EndCallback);
+};
+
+Tracer* Tracer::s_instance = nullptr;
+thread_local Tracer::Ring* Tracer::s_ring = nullptr;
+
+Tracer::Tracer(const std::string& path, const std::string& categories)
+    : m_path(path)
+{
+    bool started = false;
+    runOnUiThread([&] {
+        /* Both clocks read back to back; the trace clock is microseconds */
+        int64_t chrome = CefNowFromSystemTraceTime();
+        m_clockOffset = chrome * 1000 - Stats::now();
+        started = CefBeginTracing(categories, nullptr);
+    });
+    if (!started) {
+        throw std::runtime_error("Failed to start tracing");
+    }
+}
+
+void
+Tracer::enable(const std::string& path, const std::string& categories)
+{
+    if (!s_instance) {
+        s_instance = new Tracer(path, categories);
+    }
+}
+
+Tracer::Ring*
+Tracer::m_ring()
+{
+    if (!s_ring) {
+        auto ring = std::make_unique<Ring>();
+        ring->tid = gettid();
+        ring->spans = std::make_unique<Span[]>(RING_SIZE);
+        s_ring = ring.get();
+        std::unique_lock guard(m_lock);
+        m_rings.push_back(std::move(ring));
+    }
+    return s_ring;
+}
+
+void
+Tracer::record(const char* name, int64_t begin, int64_t end)
+{
+    Ring* ring = m_ring();
+    uint64_t count = ring->count.load(std::memory_order_relaxed);
+    ring->spans[count % RING_SIZE] = {name, begin, end};
+    ring->count.store(count + 1, std::memory_order_release);
+}
+
+void
+Tracer::finish(MessagePump& pump)
+{
+    m_recording = false;
+    m_pump = &pump;
+
+    std::string chromePath = m_path + ".chrome";
+    bool ending = false;
+    runOnUiThread([&] {
+        ending = CefEndTracing(chromePath, new EndCallback(this));
+    });
+    int64_t deadline = Stats::now() + END_TIMEOUT_NS;
+    while (ending && !m_chromeDone && Stats::now() < deadline) {
+        pump.wait(pump.timeout());
+        if (pump.due()) {
+            pump.doWork();
+        }
+    }
+    m_write(m_chromeDone ? chromePath : "");
+    unlink(chromePath.c_str());
+}
+
+void
+Tracer::m_write(const std::string& chromePath)
+{
+    std::ofstream out(m_path);
+    if (!out) {
+        throw std::runtime_error("Failed to open trace file: " + m_path);
+    }
+    out << "{\"traceEvents\":[";
+
+    /* Our spans first, as complete events in microseconds */
+    pid_t pid = getpid();
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    std::unique_lock guard(m_lock);
+    for (auto& ring : m_rings) {
+        uint64_t count = ring->count.load(std::memory_order_acquire);
+        uint64_t start = count > RING_SIZE ? count - RING_SIZE : 0;
+        for (uint64_t i = start; i < count; i++) {
+            const Span& span = ring->spans[i % RING_SIZE];
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"" << span.name << "\",\"cat\":\"nanamo\","
+                << "\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << ring->tid
+                << ",\"ts\":" << (span.begin + m_clockOffset) / 1000.0
+                << ",\"dur\":" << (span.end - span.begin) / 1000.0 << "}";
+            first = false;
+        }
+    }
+
+    /* Then Chromium's events, along with the rest of its file */
+    std::string chrome;
+    if (!chromePath.empty()) {
+        std::ifstream in(chromePath);
+        chrome.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+    }
+    static const std::string EVENTS = "\"traceEvents\":[";
+    size_t events = chrome.find(EVENTS);
+    if (events == std::string::npos) {
+        out << "]}" << std::endl;
+        return;
+    }
+    size_t rest = chrome.find_first_not_of(" \t\r\n", events + EVENTS.size());
+    if (!first && rest != std::string::npos && chrome[rest] != ']') {
+        out << ",";
+    }
+    out << "\n" << chrome.substr(events + EVENTS.size());
+}
+
+} // namespace nanamo
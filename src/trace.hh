@@ -0,0 +1,142 @@
+/** trace.hh -- Trace capture definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_TRACE_HH_
+#define NNM_TRACE_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "pump.hh"
+#include "stats.hh"
+
+namespace nanamo {
+
+/**
+ * Records nanamo's own spans alongside a Chromium trace, enabled with
+ * --trace.
+ *
+ * Every thread appends to a ring of its own, so a span costs two clock
+ * reads and no locks; while tracing is off, it costs one load. Rings keep
+ * the latest RING_SIZE spans of their thread. At the end both traces are
+ * merged into one trace event file, with our spans shifted onto Chromium's
+ * trace clock.
+ */
+class Tracer {
+  private:
+    static constexpr size_t RING_SIZE = 1 << 16;
+
+    struct Span {
+        const char* name;
+        int64_t begin;
+        int64_t end;
+    };
+
+    struct Ring {
+        pid_t tid;
+        std::atomic<uint64_t> count = 0;
+        std::unique_ptr<Span[]> spans;
+    };
+
+    class EndCallback;
+
+    static Tracer* s_instance;
+    static thread_local Ring* s_ring;
+
+    std::string m_path;
+    std::atomic<bool> m_recording = true;
+    /* Chromium's trace clock minus Stats::now(), in nanoseconds */
+    int64_t m_clockOffset;
+
+    std::mutex m_lock;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    std::atomic<bool> m_chromeDone = false;
+    MessagePump* m_pump = nullptr;
+
+    Ring* m_ring();
+    void m_write(const std::string& chromePath);
+
+    Tracer(const std::string& path, const std::string& categories);
+
+  public:
+    /**
+     * Start tracing Chromium's categories (its defaults if empty), to be
+     * written to path by finish(). CEF must be initialized.
+     */
+    static void enable(const std::string& path,
+                       const std::string& categories);
+    /** The tracer, or null if not recording */
+    static Tracer* get()
+    {
+        Tracer* tracer = s_instance;
+        return tracer && tracer->m_recording.load(std::memory_order_relaxed)
+                   ? tracer
+                   : nullptr;
+    }
+
+    void record(const char* name, int64_t begin, int64_t end);
+
+    /**
+     * Stop tracing and write the merged trace, running pump's work until
+     * Chromium has delivered its part
+     */
+    void finish(MessagePump& pump);
+};
+
+/** Records the time until the end of its scope as a span named name */
+class TraceSpan {
+  private:
+    const char* m_name;
+    Tracer* m_tracer;
+    int64_t m_begin = 0;
+
+  public:
+    explicit TraceSpan(const char* name)
+        : m_name(name), m_tracer(Tracer::get())
+    {
+        if (m_tracer) {
+            m_begin = Stats::now();
+        }
+    }
+    ~TraceSpan()
+    {
+        if (m_tracer) {
+            m_tracer->record(m_name, m_begin, Stats::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+} // namespace nanamo
+
+#endif /* NNM_TRACE_HH_ */
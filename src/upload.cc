@@ -0,0 +1,298 @@
+/** upload.cc -- Texture upload implementation */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "upload.hh"
+
+namespace nanamo {
+
+int
+TextureUploader::m_bucketOf(int size)
+{
+    return (size + BUCKET - 1) / BUCKET * BUCKET;
+}
+
+void
+TextureUploader::m_resize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+
+    int textureWidth = m_bucketOf(width);
+    int textureHeight = m_bucketOf(height);
+    if (m_texture && textureWidth == m_textureWidth &&
+        textureHeight == m_textureHeight) {
+        return;
+    }
+
+    if (m_texture) {
+        m_pool.push_back({m_texture, m_textureWidth, m_textureHeight});
+    }
+    auto pooled = std::find_if(m_pool.begin(), m_pool.end(), [&](auto& t) {
+        return t.width == textureWidth && t.height == textureHeight;
+    });
+    if (pooled != m_pool.end()) {
+        m_texture = pooled->name;
+        m_pool.erase(pooled);
+    } else {
+        /* Immutable storage can't be resized, a new size needs a new
+         * texture */
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, textureWidth,
+                       textureHeight);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        /* Pages rendered above window resolution get minified when drawn */
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    m_textureWidth = textureWidth;
+    m_textureHeight = textureHeight;
+
+    if (m_pool.size() > POOL_SIZE) {
+        glDeleteTextures(1, &m_pool.front().name);
+        m_pool.erase(m_pool.begin());
+    }
+}
+
+void
+TextureUploader::m_allocBuffer(size_t slotSize)
+{
+    m_releaseBuffer();
+
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slotSize * SLOT_COUNT, nullptr,
+                    flags);
+    m_mapped = static_cast<uint8_t*>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, slotSize * SLOT_COUNT, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!m_mapped) {
+        /* Leave the ring empty, uploads will go through client memory
+         * from now on rather than retry every paint */
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_ringFailed = true;
+        return;
+    }
+
+    m_slotSize = slotSize;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        m_slots[i].offset = slotSize * i;
+    }
+}
+
+void
+TextureUploader::m_releaseBuffer()
+{
+    for (auto& slot : m_slots) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+    }
+
+    if (m_buffer) {
+        /* The GL keeps the storage alive until pending copies are done */
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+    m_mapped = nullptr;
+    m_slotSize = 0;
+    m_nextSlot = 0;
+}
+
+TextureUploader::Slot*
+TextureUploader::m_acquireSlot()
+{
+    if (!m_mapped) {
+        return nullptr;
+    }
+
+    Slot* slot = &m_slots[m_nextSlot];
+    if (slot->fence) {
+        /* Never block the paint thread on the GPU */
+        GLenum status = glClientWaitSync(slot->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            return nullptr;
+        }
+        glDeleteSync(slot->fence);
+        slot->fence = nullptr;
+    }
+
+    m_nextSlot = (m_nextSlot + 1) % SLOT_COUNT;
+    return slot;
+}
+
+void
+TextureUploader::m_clipRects(const RectList& rects, int width, int height)
+{
+    /* Clip against the buffer so a bad rect can't read past its end */
+    m_rects.clear();
+    for (const auto& rect : rects) {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.width, width);
+        int y1 = std::min(rect.y + rect.height, height);
+        if (x1 > x0 && y1 > y0) {
+            m_rects.emplace_back(x0, y0, x1 - x0, y1 - y0);
+        }
+    }
+}
+
+void
+TextureUploader::m_submit(const void* base, int width)
+{
+    Stats* stats = Stats::get();
+    if (stats && !m_timer) {
+        m_timer.emplace(stats->uploadGpu, &stats->uploadLatency);
+    }
+    if (m_timer) {
+        m_timer->begin();
+    }
+
+    /* Let the unpack state pick each dirty rect out of the full frame, base
+     * is either the client buffer or an offset into the bound PBO. */
+    uint64_t bytes = 0;
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (const auto& rect : m_rects) {
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width,
+                        rect.height, GL_BGRA, GL_UNSIGNED_BYTE, base);
+        bytes += uint64_t(rect.width) * rect.height * 4;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    if (m_timer) {
+        m_timer->end();
+    }
+    if (stats) {
+        stats->uploadBytes += bytes;
+    }
+}
+
+void
+TextureUploader::upload(const RectList& dirtyRects, const void* data,
+                        int width, int height)
+{
+    if (width != m_width || height != m_height) {
+        m_resize(width, height);
+        /* Whatever the texture held is laid out for another size, upload
+         * the whole frame */
+        m_clipRects({CefRect(0, 0, width, height)}, width, height);
+    } else {
+        m_clipRects(dirtyRects, width, height);
+    }
+    if (m_rects.empty()) {
+        return;
+    }
+
+    /* Sized like the texture, so slots survive resizes within a bucket */
+    size_t slotSize = size_t(m_textureWidth) * m_textureHeight * 4;
+    if (slotSize != m_slotSize && !m_ringFailed) {
+        m_allocBuffer(slotSize);
+    }
+
+    Slot* slot = m_acquireSlot();
+    if (!slot) {
+        m_submit(data, width);
+        return;
+    }
+
+    /* Slots mirror the frame layout, so a rect lands at the same offset it
+     * has in the paint buffer and only its rows need copying. */
+    auto src = static_cast<const uint8_t*>(data);
+    uint8_t* dst = m_mapped + slot->offset;
+    size_t stride = size_t(width) * 4;
+    for (const auto& rect : m_rects) {
+        size_t offset = rect.y * stride + size_t(rect.x) * 4;
+        size_t rowSize = size_t(rect.width) * 4;
+        for (int y = 0; y < rect.height; y++) {
+            std::memcpy(dst + offset, src + offset, rowSize);
+            offset += stride;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    m_submit(reinterpret_cast<const void*>(slot->offset), width);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint
+TextureUploader::texture() const
+{
+    return m_texture;
+}
+
+int
+TextureUploader::width() const
+{
+    return m_width;
+}
+
+int
+TextureUploader::height() const
+{
+    return m_height;
+}
+
+void
+TextureUploader::release()
+{
+    if (m_timer) {
+        m_timer->release();
+        m_timer.reset();
+    }
+    m_releaseBuffer();
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+    for (const auto& texture : m_pool) {
+        glDeleteTextures(1, &texture.name);
+    }
+    m_pool.clear();
+    m_textureWidth = 0;
+    m_textureHeight = 0;
+    m_width = 0;
+    m_height = 0;
+}
+
+} // namespace nanamo
@@ -0,0 +1,120 @@
+/** upload.hh -- Texture upload definitions */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NNM_UPLOAD_HH_
+#define NNM_UPLOAD_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <cef_render_handler.h>
+
+#include <GL/glew.h>
+
+#include "stats.hh"
+
+namespace nanamo {
+
+/**
+ * Streams CEF paint buffers into an immutable RGBA texture.
+ *
+ * Dirty rects are copied into a ring of persistently mapped pixel unpack
+ * buffers and pulled into the texture by the GPU asynchronously. A fence
+ * guards each ring slot; if the GPU still holds every slot, the upload falls
+ * back to a plain client-memory glTexSubImage2D instead of waiting.
+ */
+class TextureUploader {
+  public:
+    typedef CefRenderHandler::RectList RectList;
+
+  private:
+    static constexpr int SLOT_COUNT = 3;
+    /* Texture sizes are rounded up to a multiple of this */
+    static constexpr int BUCKET = 128;
+    /* Textures of other sizes kept for reuse */
+    static constexpr size_t POOL_SIZE = 3;
+
+    struct Slot {
+        size_t offset = 0;
+        GLsync fence = nullptr;
+    };
+
+    struct Texture {
+        GLuint name;
+        int width;
+        int height;
+    };
+
+    GLuint m_texture = 0;
+    int m_textureWidth = 0;
+    int m_textureHeight = 0;
+    /* Least recently used first */
+    std::vector<Texture> m_pool;
+
+    /* Size of the frame in m_texture */
+    int m_width = 0;
+    int m_height = 0;
+
+    GLuint m_buffer = 0;
+    uint8_t* m_mapped = nullptr;
+    size_t m_slotSize = 0;
+    /* Set once the ring couldn't be mapped, uploads stay in client memory */
+    bool m_ringFailed = false;
+    Slot m_slots[SLOT_COUNT];
+    int m_nextSlot = 0;
+
+    std::vector<CefRect> m_rects;
+    std::optional<GpuTimer> m_timer;
+
+    static int m_bucketOf(int size);
+    void m_resize(int width, int height);
+    void m_allocBuffer(size_t slotSize);
+    void m_releaseBuffer();
+    Slot* m_acquireSlot();
+    void m_clipRects(const RectList&, int width, int height);
+    void m_submit(const void* base, int width);
+
+  public:
+    TextureUploader() = default;
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    /** Upload the dirty parts of a width x height BGRA frame */
+    void upload(const RectList& dirtyRects, const void* data, int width,
+                int height);
+
+    /** Texture holding the last uploaded frame, 0 before the first upload */
+    GLuint texture() const;
+    /** Size of the frame, the texture itself may be larger */
+    int width() const;
+    int height() const;
+    /** Free GL resources, must be called while the context is current */
+    void release();
+};
+
+} // namespace nanamo
+
+#endif /* NNM_UPLOAD_HH_ */
@@ -0,0 +1,148 @@
+/** ctl.cc -- Command line client for the nanamo daemon */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemonfmt.hh"
+
+static const char* cmdName = "nanamoctl";
+
+static void
+usage(std::ostream& os = std::cout)
+{
+    os << "usage: " << cmdName << " [options] <command> [args]..."
+       << std::endl;
+    os << "  commands:" << std::endl;
+    os << "    open URL [WxH[+X+Y]] [border] [resizable] [transparent]"
+       << std::endl;
+    os << "    close ID" << std::endl;
+    os << "    reload ID" << std::endl;
+    os << "    move ID X Y" << std::endl;
+    os << "    resize ID WIDTH HEIGHT" << std::endl;
+    os << "    list" << std::endl;
+    os << "    quit" << std::endl;
+    os << "  options:" << std::endl;
+    os << "    -h, --help\t\t"
+       << "Show this help message" << std::endl;
+    os << "    -s, --socket=PATH\t"
+       << "Daemon socket (default " << nanamo::defaultDaemonSocket() << ")"
+       << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static struct option longOpts[] = {
+        {"help", 0, nullptr, 'h'},
+        {"socket", 1, nullptr, 's'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    std::string path = nanamo::defaultDaemonSocket();
+
+    int c;
+    /* '+' stops at the command, so its arguments may look like options */
+    while ((c = getopt_long(argc, argv, "+hs:", longOpts, nullptr)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            return 0;
+        case 's':
+            path = optarg;
+            break;
+        default:
+            usage(std::cerr);
+            return -1;
+        }
+    }
+    if (optind >= argc) {
+        usage(std::cerr);
+        return -1;
+    }
+
+    std::string line;
+    for (int i = optind; i < argc; i++) {
+        line += argv[i];
+        line += i + 1 < argc ? ' ' : '\n';
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "error: socket path too long" << std::endl;
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    auto sa = reinterpret_cast<sockaddr*>(&addr);
+    if (fd < 0 || connect(fd, sa, sizeof(addr)) < 0) {
+        std::cerr << "error: " << path << ": " << std::strerror(errno)
+                  << std::endl;
+        return -1;
+    }
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) !=
+        ssize_t(line.size())) {
+        std::cerr << "error: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    /* Print data lines until the status line */
+    std::string reply;
+    char buf[4096];
+    for (;;) {
+        size_t end = reply.find('\n');
+        if (end == std::string::npos) {
+            ssize_t len = read(fd, buf, sizeof(buf));
+            if (len <= 0) {
+                std::cerr << "error: daemon hung up" << std::endl;
+                return -1;
+            }
+            reply.append(buf, len);
+            continue;
+        }
+
+        std::string status = reply.substr(0, end);
+        reply.erase(0, end + 1);
+        if (status == "ok" || status.starts_with("ok ")) {
+            if (status.size() > 3) {
+                std::cout << status.substr(3) << std::endl;
+            }
+            return 0;
+        }
+        if (status.starts_with("error ")) {
+            std::cerr << "error: " << status.substr(6) << std::endl;
+            return 1;
+        }
+        std::cout << status << std::endl;
+    }
+}
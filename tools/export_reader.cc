@@ -0,0 +1,325 @@
+/** export_reader.cc -- Reference reader for exported frames */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "exportfmt.hh"
+
+using namespace nanamo;
+
+/* Our copy of the producer's frame */
+struct Frame {
+    uint64_t number = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+struct Mapping {
+    const ExportHeader* header = nullptr;
+    size_t size = 0;
+};
+
+static const char* cmdName = "nanamo-export-reader";
+
+static void
+usage(std::ostream& os = std::cout)
+{
+    os << "usage: " << cmdName << " [options] <socket>" << std::endl;
+    os << "  options:" << std::endl;
+    os << "    -n, --frames=N\t"
+       << "Exit after reading N frames" << std::endl;
+    os << "    -o, --output=FILE\t"
+       << "Write the last frame to FILE as PAM on exit" << std::endl;
+    os << "    -q, --quiet\t\t"
+       << "Don't print a line per frame" << std::endl;
+}
+
+static int
+connectTo(const char* path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+        std::cerr << "error: socket path too long" << std::endl;
+        std::exit(-1);
+    }
+    std::strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    auto sa = reinterpret_cast<sockaddr*>(&addr);
+    if (fd < 0 || connect(fd, sa, sizeof(addr)) < 0) {
+        std::cerr << "error: " << path << ": " << std::strerror(errno)
+                  << std::endl;
+        std::exit(-1);
+    }
+    return fd;
+}
+
+/* Receive a message, and the fd passed along with it if any */
+static bool
+receive(int sock, ExportMessage& msg, int& fd)
+{
+    iovec iov = {&msg, sizeof(msg)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr hdr = {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    ssize_t len = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+    if (len != sizeof(msg)) {
+        return false;
+    }
+
+    fd = -1;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS) {
+        std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return true;
+}
+
+static bool
+mapBuffer(int fd, Mapping& mapping)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(ExportHeader)) {
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    auto header = static_cast<const ExportHeader*>(mapped);
+    if (header->magic != EXPORT_MAGIC || header->version != EXPORT_VERSION ||
+        header->slotCount != EXPORT_SLOTS ||
+        header->dataOffset + header->slotSize * EXPORT_SLOTS >
+            size_t(st.st_size)) {
+        munmap(mapped, st.st_size);
+        return false;
+    }
+
+    if (mapping.header) {
+        munmap(const_cast<ExportHeader*>(mapping.header), mapping.size);
+    }
+    mapping.header = header;
+    mapping.size = st.st_size;
+    return true;
+}
+
+/*
+ * Bring frame up to date with frame number, copying only the damaged rects
+ * when we hold its predecessor. Returns the number of bytes copied, or -1
+ * if the producer got to the slot first.
+ */
+static long
+readFrame(const Mapping& mapping, uint64_t number, Frame& frame)
+{
+    const ExportHeader* header = mapping.header;
+    int index = number % EXPORT_SLOTS;
+    const ExportSlot& slot = header->slots[index];
+
+    uint32_t lock = slot.lock.load(std::memory_order_acquire);
+    if ((lock & 1) || slot.frame != number) {
+        return -1;
+    }
+
+    uint32_t width = slot.width;
+    uint32_t height = slot.height;
+    size_t stride = size_t(width) * 4;
+    if (size_t(height) * stride > header->slotSize) {
+        return -1;
+    }
+    auto src = reinterpret_cast<const uint8_t*>(header) + header->dataOffset +
+               index * header->slotSize;
+
+    long copied = 0;
+    if (frame.number + 1 == number && frame.width == width &&
+        frame.height == height) {
+        uint32_t count = std::min<uint32_t>(slot.rectCount, EXPORT_MAX_RECTS);
+        for (uint32_t i = 0; i < count; i++) {
+            ExportRect rect = slot.rects[i];
+            int x0 = std::max(rect.x, 0);
+            int y0 = std::max(rect.y, 0);
+            int x1 = std::min<int>(rect.x + rect.width, width);
+            int y1 = std::min<int>(rect.y + rect.height, height);
+            for (int y = y0; y < y1 && x0 < x1; y++) {
+                size_t offset = y * stride + size_t(x0) * 4;
+                std::memcpy(&frame.pixels[offset], src + offset,
+                            size_t(x1 - x0) * 4);
+                copied += (x1 - x0) * 4;
+            }
+        }
+    } else {
+        frame.pixels.assign(src, src + height * stride);
+        copied = height * stride;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.lock.load(std::memory_order_relaxed) != lock) {
+        /* Torn copy, the next read has to start over from a full frame */
+        frame.number = 0;
+        return -1;
+    }
+
+    frame.number = number;
+    frame.width = width;
+    frame.height = height;
+    return copied;
+}
+
+static void
+writePam(const char* path, const Frame& frame)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << "P7\nWIDTH " << frame.width << "\nHEIGHT " << frame.height
+        << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+
+    /* Premultiplied BGRA to straight RGBA */
+    std::vector<uint8_t> row(size_t(frame.width) * 4);
+    for (uint32_t y = 0; y < frame.height; y++) {
+        const uint8_t* src = &frame.pixels[y * row.size()];
+        for (uint32_t x = 0; x < frame.width; x++, src += 4) {
+            uint8_t a = src[3];
+            for (int c = 0; c < 3; c++) {
+                row[x * 4 + c] = a ? std::min(src[2 - c] * 255 / a, 255) : 0;
+            }
+            row[x * 4 + 3] = a;
+        }
+        out.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    if (!out) {
+        std::cerr << "error: failed to write " << path << std::endl;
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    static struct option longOpts[] = {
+        {"frames", 1, nullptr, 'n'},
+        {"help", 0, nullptr, 'h'},
+        {"output", 1, nullptr, 'o'},
+        {"quiet", 0, nullptr, 'q'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    long maxFrames = 0;
+    const char* output = nullptr;
+    bool quiet = false;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hn:o:q", longOpts, nullptr)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            return 0;
+        case 'n':
+            maxFrames = std::atol(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage(std::cerr);
+            return -1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(std::cerr);
+        return -1;
+    }
+
+    int sock = connectTo(argv[optind]);
+    Mapping mapping;
+    Frame frame;
+    long frames = 0;
+
+    ExportMessage msg;
+    int fd;
+    while ((maxFrames == 0 || frames < maxFrames) &&
+           receive(sock, msg, fd)) {
+        if (msg.type == EXPORT_BUFFER) {
+            if (fd < 0 || !mapBuffer(fd, mapping)) {
+                std::cerr << "error: bad frame buffer" << std::endl;
+                return -1;
+            }
+            /* Slots of a new buffer start out empty */
+            frame.number = 0;
+        }
+        if (!mapping.header) {
+            continue;
+        }
+
+        /* Notices may lag behind, always go for the newest frame */
+        uint64_t latest =
+            mapping.header->latest.load(std::memory_order_acquire);
+        if (latest == 0 || latest == frame.number) {
+            continue;
+        }
+        uint64_t previous = frame.number;
+        long copied = readFrame(mapping, latest, frame);
+        if (copied < 0) {
+            continue;
+        }
+        frames++;
+
+        if (!quiet) {
+            std::cout << "frame " << latest << " " << frame.width << "x"
+                      << frame.height << " copied " << copied << " bytes";
+            if (previous && previous + 1 != latest) {
+                std::cout << " (skipped " << latest - previous - 1 << ")";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    if (output && frame.width > 0) {
+        writePam(output, frame);
+    }
+    close(sock);
+}
@@ -0,0 +1,206 @@
+/** ingest.cc -- Stand-in data producer for --ingest */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ingestfmt.hh"
+
+static const char* cmdName = "nanamo-ingest";
+
+/* A made-up combat log entry, what overlays typically consume */
+struct Event {
+    uint64_t sequence;
+    int64_t time; /* CLOCK_MONOTONIC nanoseconds */
+    uint32_t source;
+    uint32_t target;
+    uint32_t ability;
+    int32_t amount;
+};
+
+static void
+usage(std::ostream& os = std::cout)
+{
+    os << "usage: " << cmdName << " [options] <socket>" << std::endl;
+    os << "  Send each line of standard input as a message, or synthetic"
+       << std::endl;
+    os << "  events with --rate." << std::endl;
+    os << "  options:" << std::endl;
+    os << "    -h, --help\t\t"
+       << "Show this help message" << std::endl;
+    os << "    -r, --rate=N\t"
+       << "Send N events per second" << std::endl;
+    os << "    -s, --size=BYTES\t"
+       << "Event size, at least " << sizeof(Event) << " (default "
+       << sizeof(Event) << ")" << std::endl;
+    os << "    -n, --count=N\t"
+       << "Stop after N events (default unlimited)" << std::endl;
+}
+
+static int64_t
+now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+sendMessage(int fd, const void* data, size_t size)
+{
+    /* Blocks while nanamo is behind, which paces us to the page */
+    if (send(fd, data, size, MSG_NOSIGNAL) == ssize_t(size)) {
+        return true;
+    }
+    std::cerr << "error: " << std::strerror(errno) << std::endl;
+    return false;
+}
+
+static int
+sendLines(int fd)
+{
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line.size() > nanamo::INGEST_MAX_MESSAGE) {
+            std::cerr << "error: line longer than "
+                      << nanamo::INGEST_MAX_MESSAGE << " bytes" << std::endl;
+            return -1;
+        }
+        if (!sendMessage(fd, line.data(), line.size())) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+sendEvents(int fd, long rate, size_t size, uint64_t count)
+{
+    std::vector<uint8_t> buffer(size);
+    Event event = {};
+
+    int64_t start = now();
+    while (event.sequence < count) {
+        /* Catch up with the schedule, then sleep a millisecond */
+        int64_t elapsed = now() - start;
+        uint64_t due = uint64_t(elapsed / 1e9 * rate);
+        while (event.sequence < due && event.sequence < count) {
+            event.time = now();
+            event.source = event.sequence % 24;
+            event.target = 1000 + event.sequence % 7;
+            event.ability = event.sequence % 97;
+            event.amount = 1000 + event.sequence * 7919 % 50000;
+            std::memcpy(buffer.data(), &event, sizeof(event));
+            if (!sendMessage(fd, buffer.data(), buffer.size())) {
+                return -1;
+            }
+            event.sequence++;
+        }
+        usleep(1000);
+    }
+
+    double seconds = (now() - start) / 1e9;
+    std::cerr << "sent " << event.sequence << " events, "
+              << event.sequence * size / 1e6 << " MB in " << seconds
+              << " s" << std::endl;
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static struct option longOpts[] = {
+        {"help", 0, nullptr, 'h'},
+        {"rate", 1, nullptr, 'r'},
+        {"size", 1, nullptr, 's'},
+        {"count", 1, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    long rate = 0;
+    size_t size = sizeof(Event);
+    uint64_t count = UINT64_MAX;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hr:s:n:", longOpts, nullptr)) !=
+           -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            return 0;
+        case 'r':
+            rate = std::atol(optarg);
+            break;
+        case 's':
+            size = std::atol(optarg);
+            break;
+        case 'n':
+            count = std::strtoull(optarg, nullptr, 10);
+            break;
+        default:
+            usage(std::cerr);
+            return -1;
+        }
+    }
+    if (optind + 1 != argc || rate < 0 || size < sizeof(Event) ||
+        size > nanamo::INGEST_MAX_MESSAGE) {
+        usage(std::cerr);
+        return -1;
+    }
+    std::string path = argv[optind];
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "error: socket path too long" << std::endl;
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    auto sa = reinterpret_cast<sockaddr*>(&addr);
+    if (fd < 0 || connect(fd, sa, sizeof(addr)) < 0) {
+        std::cerr << "error: " << path << ": " << std::strerror(errno)
+                  << std::endl;
+        return -1;
+    }
+
+    int result = rate ? sendEvents(fd, rate, size, count) : sendLines(fd);
+    close(fd);
+    return result;
+}
@@ -0,0 +1,254 @@
+/** pack.cc -- Pack an overlay directory into a bundle */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <getopt.h>
+
+#include "bundlefmt.hh"
+
+using namespace nanamo;
+namespace fs = std::filesystem;
+
+/* MIME types by lowercase extension, anything else is served as
+ * application/octet-stream */
+static const std::map<std::string_view, std::string_view> mimeTypes = {
+    {".avif", "image/avif"},
+    {".css", "text/css"},
+    {".gif", "image/gif"},
+    {".htm", "text/html"},
+    {".html", "text/html"},
+    {".ico", "image/x-icon"},
+    {".jpeg", "image/jpeg"},
+    {".jpg", "image/jpeg"},
+    {".js", "text/javascript"},
+    {".json", "application/json"},
+    {".map", "application/json"},
+    {".mjs", "text/javascript"},
+    {".mp3", "audio/mpeg"},
+    {".mp4", "video/mp4"},
+    {".ogg", "audio/ogg"},
+    {".otf", "font/otf"},
+    {".png", "image/png"},
+    {".svg", "image/svg+xml"},
+    {".ttf", "font/ttf"},
+    {".txt", "text/plain"},
+    {".wasm", "application/wasm"},
+    {".wav", "audio/wav"},
+    {".webm", "video/webm"},
+    {".webp", "image/webp"},
+    {".woff", "font/woff"},
+    {".woff2", "font/woff2"},
+    {".xml", "application/xml"},
+};
+
+struct Input {
+    fs::path file;
+    std::string path;
+    std::string_view mime;
+    uint64_t size;
+};
+
+static const char* cmdName = "nanamo-pack";
+
+static void
+usage(std::ostream& os = std::cout)
+{
+    os << "usage: " << cmdName << " [options] <directory> <bundle>"
+       << std::endl;
+    os << "  Packs every file below directory into a bundle for --bundle"
+       << std::endl;
+    os << "  options:" << std::endl;
+    os << "    -h, --help\t\t"
+       << "Show this help message" << std::endl;
+    os << "    -v, --verbose\t"
+       << "List every file packed" << std::endl;
+}
+
+static std::string_view
+mimeOf(const fs::path& file)
+{
+    std::string ext = file.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    auto it = mimeTypes.find(ext);
+    return it != mimeTypes.end() ? it->second : "application/octet-stream";
+}
+
+static uint64_t
+align(uint64_t offset)
+{
+    return (offset + BUNDLE_ALIGN - 1) & ~(BUNDLE_ALIGN - 1);
+}
+
+static void
+pad(std::ostream& out, uint64_t& offset, uint64_t to)
+{
+    static const char zeros[BUNDLE_ALIGN] = {};
+    out.write(zeros, to - offset);
+    offset = to;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static struct option longOpts[] = {
+        {"help", 0, nullptr, 'h'},
+        {"verbose", 0, nullptr, 'v'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    bool verbose = false;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hv", longOpts, nullptr)) != -1) {
+        switch (c) {
+        case 'h':
+            usage();
+            return 0;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(std::cerr);
+            return -1;
+        }
+    }
+    if (optind + 2 != argc) {
+        usage(std::cerr);
+        return -1;
+    }
+    fs::path root = argv[optind];
+    std::string outPath = argv[optind + 1];
+
+    std::vector<Input> inputs;
+    std::error_code error;
+    for (fs::recursive_directory_iterator
+             it(root, fs::directory_options::follow_directory_symlink, error),
+         end;
+         !error && it != end; it.increment(error)) {
+        std::error_code same;
+        if (!it->is_regular_file() ||
+            fs::equivalent(it->path(), outPath, same)) {
+            /* Including an old copy of the bundle itself */
+            continue;
+        }
+        Input input;
+        input.file = it->path();
+        input.path = it->path().lexically_relative(root).generic_string();
+        input.mime = mimeOf(input.file);
+        input.size = it->file_size();
+        inputs.push_back(std::move(input));
+    }
+    if (error) {
+        std::cerr << "error: " << root.string() << ": " << error.message()
+                  << std::endl;
+        return -1;
+    }
+    /* Bytewise, as nanamo looks paths up */
+    std::sort(inputs.begin(), inputs.end(),
+              [](const Input& a, const Input& b) { return a.path < b.path; });
+
+    /* Strings follow the index, MIME types once each; then the contents */
+    std::vector<BundleEntry> entries(inputs.size());
+    std::map<std::string_view, uint64_t> mimeOffsets;
+    std::string strings;
+    uint64_t stringsOffset =
+        sizeof(BundleHeader) + entries.size() * sizeof(BundleEntry);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        entries[i].pathOffset = stringsOffset + strings.size();
+        entries[i].pathSize = inputs[i].path.size();
+        strings += inputs[i].path;
+
+        auto [it, added] = mimeOffsets.emplace(
+            inputs[i].mime, stringsOffset + strings.size());
+        if (added) {
+            strings += inputs[i].mime;
+        }
+        entries[i].mimeOffset = it->second;
+        entries[i].mimeSize = inputs[i].mime.size();
+    }
+    uint64_t offset = stringsOffset + strings.size();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        offset = align(offset);
+        entries[i].dataOffset = offset;
+        entries[i].dataSize = inputs[i].size;
+        offset += inputs[i].size;
+    }
+
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "error: can't write " << outPath << std::endl;
+        return -1;
+    }
+    BundleHeader header = {};
+    std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.entryCount = entries.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              entries.size() * sizeof(BundleEntry));
+    out.write(strings.data(), strings.size());
+
+    offset = stringsOffset + strings.size();
+    std::vector<char> buffer;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        pad(out, offset, entries[i].dataOffset);
+        std::ifstream in(inputs[i].file, std::ios::binary);
+        buffer.resize(inputs[i].size);
+        /* Files that change size while packing would corrupt the index */
+        if (!in.read(buffer.data(), buffer.size()) || in.peek() != EOF) {
+            std::cerr << "error: can't read " << inputs[i].file.string()
+                      << ", or it changed" << std::endl;
+            out.close();
+            fs::remove(outPath, error);
+            return -1;
+        }
+        out.write(buffer.data(), buffer.size());
+        offset += buffer.size();
+        if (verbose) {
+            std::cout << inputs[i].path << "\t" << inputs[i].mime << "\t"
+                      << inputs[i].size << std::endl;
+        }
+    }
+
+    if (!out.flush()) {
+        std::cerr << "error: can't write " << outPath << std::endl;
+        fs::remove(outPath, error);
+        return -1;
+    }
+    std::cout << "packed " << inputs.size() << " files, " << offset
+              << " bytes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,400 @@
+/** replay.cc -- Rebuild frames from a recording */
+
+/*
+ * Copyright 2024 Youkou Tenhouin <youkou@tenhou.in>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <zlib.h>
+
+#include "recordfmt.hh"
+
+using namespace nanamo;
+
+/* Frame rebuilt from the records read so far, premultiplied BGRA */
+struct Canvas {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+static const char* cmdName = "nanamo-replay";
+
+static void
+usage(std::ostream& os = std::cout)
+{
+    os << "usage: " << cmdName << " [options] <recording>" << std::endl;
+    os << "  Prints every record and frame timing statistics, unless asked "
+          "to export frames"
+       << std::endl;
+    os << "  options:" << std::endl;
+    os << "    -h, --help\t\t"
+       << "Show this help message" << std::endl;
+    os << "    -p, --png=DIR\t"
+       << "Write every recorded frame to DIR as PNG" << std::endl;
+    os << "    -y, --y4m=FILE\t"
+       << "Write a constant frame rate Y4M video to FILE" << std::endl;
+    os << "    -f, --fps=N\t\t"
+       << "Frame rate of the Y4M video (default 60)" << std::endl;
+}
+
+/* Read the header and rects of a record, false at the end of in or if they
+ * are corrupt, which leaves in.eof() unset */
+static bool
+readRecord(std::istream& in, RecordFrame& frame,
+           std::vector<RecordRect>& rects)
+{
+    if (!in.read(reinterpret_cast<char*>(&frame), sizeof(frame))) {
+        return false;
+    }
+    if (frame.width > RECORD_MAX_SIZE || frame.height > RECORD_MAX_SIZE ||
+        frame.rectCount > RECORD_MAX_RECTS ||
+        frame.rectCount > uint64_t(frame.width) * frame.height) {
+        /* Corrupt, not the end of the file */
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+    rects.resize(frame.rectCount);
+    return bool(in.read(reinterpret_cast<char*>(rects.data()),
+                        rects.size() * sizeof(RecordRect)));
+}
+
+/* Read the pixels following a record into canvas, false if malformed */
+static bool
+applyRecord(std::istream& in, const RecordFrame& frame,
+            const std::vector<RecordRect>& rects, Canvas& canvas)
+{
+    if (frame.width != uint32_t(canvas.width) ||
+        frame.height != uint32_t(canvas.height)) {
+        if (frame.type != RECORD_KEYFRAME) {
+            return false;
+        }
+        canvas.width = frame.width;
+        canvas.height = frame.height;
+        canvas.pixels.assign(size_t(frame.width) * frame.height * 4, 0);
+    }
+
+    size_t stride = size_t(canvas.width) * 4;
+    for (const auto& rect : rects) {
+        if (rect.x < 0 || rect.y < 0 || rect.width < 0 || rect.height < 0 ||
+            int64_t(rect.x) + rect.width > canvas.width ||
+            int64_t(rect.y) + rect.height > canvas.height) {
+            return false;
+        }
+        uint8_t* row = &canvas.pixels[rect.y * stride + size_t(rect.x) * 4];
+        size_t len = size_t(rect.width) * 4;
+        for (int y = 0; y < rect.height; y++, row += stride) {
+            if (!in.read(reinterpret_cast<char*>(row), len)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void
+writeChunk(std::ostream& out, const char* type, const uint8_t* data,
+           uint32_t len)
+{
+    uint8_t header[8] = {uint8_t(len >> 24), uint8_t(len >> 16),
+                         uint8_t(len >> 8),  uint8_t(len),
+                         uint8_t(type[0]),   uint8_t(type[1]),
+                         uint8_t(type[2]),   uint8_t(type[3])};
+    uLong crc = crc32(0, header + 4, 4);
+    if (len > 0) {
+        /* A null buffer would reset the crc */
+        crc = crc32(crc, data, len);
+    }
+    uint8_t trailer[4] = {uint8_t(crc >> 24), uint8_t(crc >> 16),
+                          uint8_t(crc >> 8), uint8_t(crc)};
+
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(data), len);
+    out.write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+}
+
+static bool
+writePng(const std::string& path, const Canvas& canvas)
+{
+    /* Rows of straight RGBA, each behind a filter type byte of 0 */
+    size_t rowSize = size_t(canvas.width) * 4 + 1;
+    std::vector<uint8_t> raw(rowSize * canvas.height);
+    for (int y = 0; y < canvas.height; y++) {
+        const uint8_t* src = &canvas.pixels[y * (rowSize - 1)];
+        uint8_t* dst = &raw[y * rowSize];
+        *dst++ = 0;
+        for (int x = 0; x < canvas.width; x++, src += 4, dst += 4) {
+            uint8_t a = src[3];
+            for (int c = 0; c < 3; c++) {
+                dst[c] = a ? std::min(src[2 - c] * 255 / a, 255) : 0;
+            }
+            dst[3] = a;
+        }
+    }
+
+    uLongf len = compressBound(raw.size());
+    std::vector<uint8_t> compressed(len);
+    if (compress2(compressed.data(), &len, raw.data(), raw.size(), 6) !=
+        Z_OK) {
+        return false;
+    }
+
+    uint32_t w = canvas.width;
+    uint32_t h = canvas.height;
+    uint8_t ihdr[13] = {uint8_t(w >> 24), uint8_t(w >> 16), uint8_t(w >> 8),
+                        uint8_t(w),       uint8_t(h >> 24), uint8_t(h >> 16),
+                        uint8_t(h >> 8),  uint8_t(h),
+                        8, /* bit depth */
+                        6, /* RGBA */
+                        0,  0, 0};
+
+    std::ofstream out(path, std::ios::binary);
+    out.write("\x89PNG\r\n\x1a\n", 8);
+    writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    writeChunk(out, "IDAT", compressed.data(), len);
+    writeChunk(out, "IEND", nullptr, 0);
+    return bool(out);
+}
+
+/* Write canvas as one 4:2:0 frame of width x height, composited on black */
+static void
+writeY4mFrame(std::ostream& out, const Canvas& canvas, int width,
+              int height, std::vector<uint8_t>& planes)
+{
+    int cw = (width + 1) / 2;
+    int ch = (height + 1) / 2;
+    planes.assign(size_t(width) * height + 2 * size_t(cw) * ch, 0);
+    uint8_t* yPlane = planes.data();
+    uint8_t* uPlane = yPlane + size_t(width) * height;
+    uint8_t* vPlane = uPlane + size_t(cw) * ch;
+    std::fill(uPlane, planes.data() + planes.size(), 128);
+
+    /* Full range BT.601, as C420jpeg implies. Premultiplied color already
+     * is the color over black. */
+    auto pixel = [&](int x, int y, float rgb[3]) {
+        if (x >= canvas.width || y >= canvas.height) {
+            rgb[0] = rgb[1] = rgb[2] = 0;
+            return;
+        }
+        const uint8_t* p = &canvas.pixels[(size_t(y) * canvas.width + x) * 4];
+        rgb[0] = p[2];
+        rgb[1] = p[1];
+        rgb[2] = p[0];
+    };
+
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            float cb = 0, cr = 0;
+            int count = 0;
+            for (int y = cy * 2; y < std::min(cy * 2 + 2, height); y++) {
+                for (int x = cx * 2; x < std::min(cx * 2 + 2, width); x++) {
+                    float rgb[3];
+                    pixel(x, y, rgb);
+                    float luma =
+                        0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2];
+                    yPlane[size_t(y) * width + x] = uint8_t(luma + 0.5f);
+                    cb += 128 - 0.168736f * rgb[0] - 0.331264f * rgb[1] +
+                          0.5f * rgb[2];
+                    cr += 128 + 0.5f * rgb[0] - 0.418688f * rgb[1] -
+                          0.081312f * rgb[2];
+                    count++;
+                }
+            }
+            uPlane[size_t(cy) * cw + cx] = uint8_t(cb / count + 0.5f);
+            vPlane[size_t(cy) * cw + cx] = uint8_t(cr / count + 0.5f);
+        }
+    }
+
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+}
+
+static int64_t
+percentile(std::vector<int64_t> values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    size_t i = std::min(size_t(p * values.size()), values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+
+int
+main(int argc, char* argv[])
+{
+    static struct option longOpts[] = {
+        {"fps", 1, nullptr, 'f'},
+        {"help", 0, nullptr, 'h'},
+        {"png", 1, nullptr, 'p'},
+        {"y4m", 1, nullptr, 'y'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    std::string pngDir;
+    std::string y4mPath;
+    int fps = 60;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "f:hp:y:", longOpts, nullptr)) !=
+           -1) {
+        switch (c) {
+        case 'f':
+            fps = std::atoi(optarg);
+            if (fps <= 0) {
+                std::cerr << "error: bad frame rate " << optarg << std::endl;
+                return -1;
+            }
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'p':
+            pngDir = optarg;
+            break;
+        case 'y':
+            y4mPath = optarg;
+            break;
+        default:
+            usage(std::cerr);
+            return -1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(std::cerr);
+        return -1;
+    }
+
+    std::ifstream in(argv[optind], std::ios::binary);
+    RecordHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != RECORD_VERSION) {
+        std::cerr << "error: " << argv[optind] << " is not a recording"
+                  << std::endl;
+        return -1;
+    }
+
+    bool info = pngDir.empty() && y4mPath.empty();
+    std::ofstream y4m;
+    int videoWidth = 0;
+    int videoHeight = 0;
+    int64_t period = 1'000'000'000 / fps;
+    int64_t nextTick = 0;
+    std::vector<uint8_t> planes;
+
+    Canvas canvas;
+    RecordFrame frame;
+    std::vector<RecordRect> rects;
+    std::vector<int64_t> intervals;
+    int64_t lastTime = 0;
+    long records = 0;
+    long keyframes = 0;
+    uint64_t bytes = 0;
+
+    while (readRecord(in, frame, rects)) {
+        if (!y4mPath.empty() && records > 0) {
+            /* Ticks up to this record show the frame before it */
+            for (; nextTick < frame.time; nextTick += period) {
+                writeY4mFrame(y4m, canvas, videoWidth, videoHeight, planes);
+            }
+        }
+
+        if (!applyRecord(in, frame, rects, canvas)) {
+            std::cerr << "error: corrupt record " << records << std::endl;
+            return -1;
+        }
+
+        uint64_t recordBytes = 0;
+        for (const auto& rect : rects) {
+            recordBytes += uint64_t(rect.width) * rect.height * 4;
+        }
+        if (records > 0) {
+            intervals.push_back(frame.time - lastTime);
+        }
+        if (info) {
+            std::printf("%10.3f ms  %s  %dx%d  %zu rects  %llu bytes\n",
+                        frame.time / 1e6,
+                        frame.type == RECORD_KEYFRAME ? "key  " : "delta",
+                        canvas.width, canvas.height, rects.size(),
+                        (unsigned long long)recordBytes);
+        }
+
+        if (!pngDir.empty()) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/%06ld.png", records);
+            if (!writePng(pngDir + name, canvas)) {
+                std::cerr << "error: failed to write " << pngDir + name
+                          << std::endl;
+                return -1;
+            }
+        }
+
+        if (!y4mPath.empty() && records == 0) {
+            /* Y4M can't change size, later frames are cropped or padded */
+            videoWidth = canvas.width;
+            videoHeight = canvas.height;
+            y4m.open(y4mPath, std::ios::binary);
+            y4m << "YUV4MPEG2 W" << videoWidth << " H" << videoHeight << " F"
+                << fps << ":1 Ip A1:1 C420jpeg\n";
+            nextTick = frame.time;
+        }
+
+        lastTime = frame.time;
+        records++;
+        keyframes += frame.type == RECORD_KEYFRAME;
+        bytes += recordBytes;
+    }
+
+    if (!in.eof()) {
+        std::cerr << "error: corrupt record " << records << std::endl;
+        return -1;
+    }
+
+    if (!y4mPath.empty() && records > 0) {
+        writeY4mFrame(y4m, canvas, videoWidth, videoHeight, planes);
+        if (!y4m) {
+            std::cerr << "error: failed to write " << y4mPath << std::endl;
+            return -1;
+        }
+    }
+
+    if (info) {
+        std::printf("%ld records, %ld keyframes, %.1f MiB of pixels over "
+                    "%.3f s\n",
+                    records, keyframes, bytes / 1048576.0, lastTime / 1e9);
+        std::printf("paint interval p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                    percentile(intervals, 0.5) / 1e6,
+                    percentile(intervals, 0.99) / 1e6,
+                    percentile(intervals, 1.0) / 1e6);
+    }
+}